@@ -0,0 +1,484 @@
+/* cache.c: Sector buffer cache for the file system disk.
+ *
+ * file system disk의 sector들을 CACHE_SIZE 개까지 memory에 들고 있음. 읽기는
+ * cache에 있으면 disk를 읽지 않고, 쓰기는 cache에만 하고 dirty로 표시해 두었다가
+ * (write-behind) 쫓겨날 때나 flush thread가 주기적으로, 그리고 filesys_done 에서
+ * 한번에 disk에 씀. 쫓아낼 entry는 CLOCK 으로 고름.
+ *
+ * caller의 buffer는 user memory일 수도 있어서 복사하는 동안 page fault가 나고, 그
+ * fault 처리가 다시 file을 읽을 수 있음. 그래서 복사는 cache_lock 없이 하고, 그
+ * 동안 entry는 pin 해서 쫓겨나지 않게 함.
+ *
+ * disk에서 읽거나 쓰는 동안에도 cache_lock 을 놓고 entry를 loading 이나
+ * writing 으로 표시해 두므로 다른 sector를 쓰는 thread들은 기다리지 않음. 순차 읽기에서 요청된 read-ahead는
+ * queue에 넣어두면 readahead thread가 뒤에서 미리 읽어둠.
+ *
+ * cache_write_meta 로 쓴 metadata sector는 journal에 commit 될 때까지 (meta)
+ * 제자리에 쓰지도, 쫓아내지도 않음. commit 된 뒤에는 (logged) 보통의 dirty
+ * sector처럼 write-behind 되고, 다 쓰이면 journal을 비움. journal.c 참고. */
+
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+/* Number of sectors kept in memory. */
+#define CACHE_SIZE 64
+
+/* Dirty sectors are written back at least this often (in ticks). */
+#define CACHE_FLUSH_INTERVAL TIMER_FREQ
+
+/* Maximum number of sectors waiting to be read ahead. */
+#define READAHEAD_QUEUE_SIZE 32
+
+/* A cached disk sector. */
+struct cache_entry {
+	disk_sector_t sector;               /* Sector held, if valid. */
+	bool valid;                         /* Holds a sector at all? */
+	bool dirty;                         /* Changed since read or last written back? */
+	bool accessed;                      /* Used since the clock hand passed? */
+	bool loading;                       /* disk에서 읽는 중이면 true, data를 쓰면 안됨 */
+	bool writing;                       /* disk에 쓰는 중이면 true, 끝나야 다시 쓸 수 있음 */
+	bool meta;                          /* commit 전의 metadata, 제자리에 쓰면 안됨 */
+	bool logged;                        /* journal에 commit 됐지만 제자리에는 아직 안 쓴 metadata */
+	int pin_cnt;                        /* 복사 중인 reader/writer 수, 0이 아니면 쫓겨나지 않음 */
+	uint8_t data[DISK_SECTOR_SIZE];     /* Sector contents. */
+};
+
+static struct cache_entry cache[CACHE_SIZE];
+static struct lock cache_lock;          /* 모든 entry의 정보를 보호함 (data 복사는 pin 으로) */
+static size_t clock_hand;               /* 다음에 쫓아낼 후보 */
+static struct condition cache_loaded;   /* loading 이 끝날 때마다 알림 */
+static struct condition cache_released; /* entry가 unpin 되거나 commit 되어 쫓아낼 수 있게 되면 알림 */
+static struct condition cache_written;  /* writing 이 끝날 때마다 알림 */
+static size_t meta_cnt;                 /* meta 인 entry 수, JOURNAL_SLOTS 를 넘지 않음 */
+static size_t meta_reserved;            /* 진행 중인 작업들이 예약해두고 아직 쓰지 않은 journal slot 수 */
+static bool journal_live;               /* journal에 checkpoint 안 끝난 transaction이 있음 */
+static bool committing;                 /* commit 중, checkpoint 동안 cache_lock 을 놓으므로 다른 commit은 기다림 */
+
+/* Read-ahead requests, a ring buffer protected by cache_lock. */
+static disk_sector_t ra_queue[READAHEAD_QUEUE_SIZE];
+static size_t ra_head;                  /* 가장 오래된 요청 */
+static size_t ra_cnt;                   /* 쌓여있는 요청 수 */
+static struct semaphore ra_sema;        /* 요청이 들어올 때마다 올림 */
+
+/* Statistics. */
+static long long stat_hits;             /* Accesses served from the cache. */
+static long long stat_misses;           /* Accesses that had to load an entry. */
+static long long stat_writebacks;       /* Dirty sectors written to disk. */
+static long long stat_readaheads;       /* Sectors read ahead in the background. */
+
+static void cache_flusher (void *aux);
+static void cache_readahead_thread (void *aux);
+
+/* Initializes the buffer cache and starts the write-behind and
+ * read-ahead threads. */
+void
+cache_init (void) {
+	lock_init (&cache_lock);
+	cond_init (&cache_loaded);
+	cond_init (&cache_released);
+	cond_init (&cache_written);
+	sema_init (&ra_sema, 0);
+	thread_create ("cache_flush", PRI_DEFAULT, cache_flusher, NULL);
+	thread_create ("cache_readahead", PRI_DEFAULT, cache_readahead_thread, NULL);
+}
+
+/* Unpins E, waking up the threads waiting for an entry to reuse if
+ * it was the last pin.  Must hold cache_lock. */
+static void
+cache_unpin (struct cache_entry *e) {
+	ASSERT (e->pin_cnt > 0);
+	if (--e->pin_cnt == 0)
+		cond_broadcast (&cache_released, &cache_lock);
+}
+
+/* Writes E back to disk if it is dirty, unless it holds metadata
+ * that has not been committed yet.  If another thread is already
+ * writing E, waits for it first, so that E's contents as of the call
+ * are on disk on return.  E is pinned and marked writing while
+ * cache_lock is released for the write.  Must hold cache_lock. */
+static void
+cache_writeback (struct cache_entry *e) {
+	while (e->writing)
+		cond_wait (&cache_written, &cache_lock);
+	if (!e->valid || !e->dirty || e->meta)
+		return;
+
+	e->pin_cnt++; // 쓰는 동안 쫓겨나지 않게 함
+	e->writing = true;
+	e->dirty = false; // 쓰는 동안 새로 쓰이면 다시 dirty 가 됨
+	lock_release (&cache_lock); // 쓰는 동안 다른 entry의 접근은 막지 않음
+	disk_write (filesys_disk, e->sector, e->data);
+	lock_acquire (&cache_lock);
+	e->writing = false;
+	e->logged = false; // 다 쓰인 뒤에야 journal을 비울 수 있음
+	stat_writebacks++;
+	cond_broadcast (&cache_written, &cache_lock);
+	cache_unpin (e);
+}
+
+/* Returns the entry holding SECTOR, or a null pointer.  Must hold
+ * cache_lock. */
+static struct cache_entry *
+cache_lookup (disk_sector_t sector) {
+	for (size_t i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].valid && cache[i].sector == sector)
+			return &cache[i];
+	return NULL;
+}
+
+/* Picks an entry to reuse with the CLOCK algorithm, writing its old
+ * sector back first if it is dirty.  Returns a null pointer if every
+ * entry is pinned or holds uncommitted metadata.  Must hold
+ * cache_lock, which is released while an old sector is written, so
+ * the caller must look its sector up again. */
+static struct cache_entry *
+cache_evict (void) {
+	for (size_t i = 0; i < 2 * CACHE_SIZE; i++) { // 두 바퀴 돌면 accessed 는 모두 지워짐
+		struct cache_entry *e = &cache[clock_hand];
+		clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+		if (!e->valid)
+			return e;
+		if (e->pin_cnt > 0 || e->meta) // 복사 중이거나 아직 commit 안 된 entry는 건너뜀
+			continue;
+		if (e->accessed) { // 최근에 쓰인 entry는 한번 더 기회를 줌
+			e->accessed = false;
+			continue;
+		}
+		cache_writeback (e);
+		if (e->pin_cnt > 0 || e->dirty || e->meta || e->accessed) // 쓰는 동안 다른 thread가 다시 썼거나 읽었음
+			continue;
+		e->valid = false;
+		return e;
+	}
+	return NULL;
+}
+
+/* Makes the free entry E hold SECTOR, pins it and marks it as
+ * loading.  If FILL, reads the sector into it with cache_lock
+ * released and clears loading.  Otherwise the caller overwrites the
+ * whole sector and must clear loading itself once done, since E
+ * still holds the bytes of its old sector until then.  Must hold
+ * cache_lock. */
+static void
+cache_load (struct cache_entry *e, disk_sector_t sector, bool fill) {
+	e->sector = sector;
+	e->valid = true;
+	e->dirty = false;
+	e->meta = false;
+	e->logged = false;
+	e->accessed = false;
+	e->pin_cnt++;
+	e->loading = true; // 다 채워질 때까지는 다른 thread가 옛 sector의 data를 읽으면 안됨
+	if (fill) {
+		lock_release (&cache_lock); // 읽는 동안 다른 sector의 접근은 막지 않음
+		disk_read (filesys_disk, sector, e->data);
+		lock_acquire (&cache_lock);
+		e->loading = false;
+		cond_broadcast (&cache_loaded, &cache_lock);
+	}
+}
+
+/* Returns the pinned entry for SECTOR, loading it on a miss.  If
+ * FILL is false the caller overwrites the whole sector, so it is
+ * not read from disk and the entry may still be loading.  Waits if
+ * no entry can be reused.  Must hold cache_lock. */
+static struct cache_entry *
+cache_get (disk_sector_t sector, bool fill) {
+	struct cache_entry *e;
+
+	for (;;) {
+		e = cache_lookup (sector);
+		if (e != NULL) {
+			stat_hits++;
+			e->pin_cnt++;
+			while (e->loading) // read-ahead나 다른 thread가 아직 채우고 있음
+				cond_wait (&cache_loaded, &cache_lock);
+			break;
+		}
+		e = cache_evict ();
+		if (e != NULL && cache_lookup (sector) != NULL) // 쫓아내는 동안 다른 thread가 SECTOR를 읽어옴, e는 빈 채로 남음
+			continue;
+		if (e != NULL) {
+			stat_misses++;
+			cache_load (e, sector, fill);
+			break;
+		}
+		cond_wait (&cache_released, &cache_lock); // 기다리는 동안 누가 SECTOR를 읽어올 수도 있으니 다시 찾음
+	}
+	e->accessed = true;
+	return e;
+}
+
+/* Reads SIZE bytes at offset OFS of SECTOR into BUFFER. */
+void
+cache_read (disk_sector_t sector, void *buffer, size_t ofs, size_t size) {
+	struct cache_entry *e;
+
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+	lock_acquire (&cache_lock);
+	e = cache_get (sector, true);
+	lock_release (&cache_lock);
+
+	memcpy (buffer, e->data + ofs, size);
+
+	lock_acquire (&cache_lock);
+	cache_unpin (e);
+	lock_release (&cache_lock);
+}
+
+/* Returns true if some uncommitted metadata sector is being copied
+ * into or out of.  Must hold cache_lock. */
+static bool
+cache_meta_pinned (void) {
+	for (size_t i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].meta && cache[i].pin_cnt > 0)
+			return true;
+	return false;
+}
+
+/* Logs every uncommitted metadata sector to the journal and commits
+ * them as one transaction.  The committed transaction before it is
+ * checkpointed first, since its journal slots are reused.  Waits
+ * until no metadata sector is in the middle of a copy, so that only
+ * whole writes are logged.  Must hold cache_lock. */
+static void
+cache_commit_locked (void) {
+	disk_sector_t sectors[JOURNAL_SLOTS];
+	size_t i, cnt = 0;
+
+	while (committing)
+		cond_wait (&cache_released, &cache_lock);
+	committing = true;
+	if (journal_live) {
+		for (i = 0; i < CACHE_SIZE; i++)
+			if (cache[i].logged)
+				cache_writeback (&cache[i]); // cache_lock 을 놓았다 다시 잡음
+		journal_write_header (NULL, 0); // slot들을 덮어쓰기 전에 지난 transaction을 지움
+		journal_live = false;
+	}
+	while (cache_meta_pinned ())
+		cond_wait (&cache_released, &cache_lock);
+	if (meta_cnt == 0) { // 기다리는 동안 다른 thread가 commit 했을 수 있음
+		committing = false;
+		cond_broadcast (&cache_released, &cache_lock);
+		return;
+	}
+
+	for (i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].meta) {
+			journal_write_slot (cnt, cache[i].data);
+			sectors[cnt++] = cache[i].sector;
+		}
+	journal_write_header (sectors, cnt);
+	journal_live = true;
+
+	for (i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].meta) {
+			cache[i].meta = false;
+			cache[i].logged = true; // 이제 제자리에 써도 됨
+		}
+	meta_cnt = 0;
+	committing = false;
+	cond_broadcast (&cache_released, &cache_lock);
+}
+
+/* Commits the metadata written so far to the journal. */
+void
+cache_commit (void) {
+	lock_acquire (&cache_lock);
+	cache_commit_locked ();
+	lock_release (&cache_lock);
+}
+
+/* Returns the number of metadata sectors waiting for a commit. */
+size_t
+cache_meta_count (void) {
+	return meta_cnt;
+}
+
+/* Reserves CNT journal slots for the file system operation the
+ * current thread is starting.  Returns false if the running
+ * transaction does not have that many slots left. */
+bool
+cache_reserve (size_t cnt) {
+	bool success;
+
+	lock_acquire (&cache_lock);
+	success = meta_cnt + meta_reserved + cnt <= JOURNAL_SLOTS;
+	if (success) {
+		meta_reserved += cnt;
+		thread_current ()->journal_left = cnt;
+	}
+	lock_release (&cache_lock);
+	return success;
+}
+
+/* Gives back the journal slots the current thread's operation
+ * reserved but did not use. */
+void
+cache_unreserve (void) {
+	struct thread *t = thread_current ();
+
+	lock_acquire (&cache_lock);
+	ASSERT (meta_reserved >= t->journal_left);
+	meta_reserved -= t->journal_left;
+	t->journal_left = 0;
+	lock_release (&cache_lock);
+}
+
+/* Takes a journal slot for a sector that becomes uncommitted
+ * metadata, from the reservation of the current thread's operation
+ * if it has one left.  Must hold cache_lock. */
+static void
+cache_charge (void) {
+	struct thread *t = thread_current ();
+
+	if (t->journal_left > 0) {
+		t->journal_left--;
+		meta_reserved--;
+	} else
+		while (meta_cnt + meta_reserved >= JOURNAL_SLOTS) { // format 처럼 작업 밖에서 쓸 때만 가득 참
+			ASSERT (t->journal_depth == 0); // 작업은 예약한 것보다 많이 쓰지 않아야 함
+			cache_commit_locked ();
+		}
+	meta_cnt++;
+}
+
+/* Writes SIZE bytes from BUFFER at offset OFS of SECTOR, which holds
+ * metadata if META is true. */
+static void
+cache_put (disk_sector_t sector, const void *buffer, size_t ofs, size_t size,
+		bool meta) {
+	struct cache_entry *e;
+	bool log = meta && journal_enabled ();
+
+	ASSERT (ofs + size <= DISK_SECTOR_SIZE);
+	lock_acquire (&cache_lock);
+	e = cache_get (sector, ofs > 0 || size < DISK_SECTOR_SIZE); // sector 전체를 덮어쓰면 미리 읽을 필요 없음
+	if (e->logged || (log && !e->meta)) // 복사 중에 flush가 commit 안 된 내용을 제자리에 쓰지 않게 먼저 써둠
+		cache_writeback (e);
+	lock_release (&cache_lock);
+
+	memcpy (e->data + ofs, buffer, size);
+
+	lock_acquire (&cache_lock);
+	if (log && !e->meta) { // 복사가 끝난 뒤에 표시해야 commit이 반만 쓰인 sector를 기록하지 않음
+		cache_charge ();
+		e->meta = true;
+	}
+	e->dirty = true; // 복사가 끝난 뒤에 표시해야 그 사이의 flush가 이 쓰기를 놓치지 않음
+	if (e->loading) { // 새로 잡은 entry를 통째로 덮어씀, 이제 읽어도 됨
+		e->loading = false;
+		cond_broadcast (&cache_loaded, &cache_lock);
+	}
+	cache_unpin (e);
+	lock_release (&cache_lock);
+}
+
+/* Writes SIZE bytes from BUFFER at offset OFS of SECTOR.  The sector
+ * reaches the disk later, see cache_flush(). */
+void
+cache_write (disk_sector_t sector, const void *buffer, size_t ofs, size_t size) {
+	cache_put (sector, buffer, ofs, size, false);
+}
+
+/* Like cache_write(), for a sector that holds file system metadata.
+ * The sector reaches its home location only after it has been
+ * committed to the journal. */
+void
+cache_write_meta (disk_sector_t sector, const void *buffer, size_t ofs, size_t size) {
+	cache_put (sector, buffer, ofs, size, true);
+}
+
+/* Returns true if some committed metadata sector has not reached its
+ * home location yet.  Must hold cache_lock. */
+static bool
+cache_logged (void) {
+	for (size_t i = 0; i < CACHE_SIZE; i++)
+		if (cache[i].logged)
+			return true;
+	return false;
+}
+
+/* Writes every dirty sector back to disk, except metadata that has
+ * not been committed.  Once every committed sector is in place the
+ * journal is emptied. */
+void
+cache_flush (void) {
+	lock_acquire (&cache_lock);
+	for (size_t i = 0; i < CACHE_SIZE; i++)
+		cache_writeback (&cache[i]);
+	if (journal_live && !committing && !cache_logged ()) { // 쓰는 동안 새로 commit 된 sector가 있으면 다음 flush에서 비움
+		journal_write_header (NULL, 0);
+		journal_live = false;
+	}
+	lock_release (&cache_lock);
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache.  Does
+ * nothing if it is cached already or too many requests are
+ * pending. */
+void
+cache_readahead (disk_sector_t sector) {
+	bool queued = false;
+
+	lock_acquire (&cache_lock);
+	if (ra_cnt < READAHEAD_QUEUE_SIZE && cache_lookup (sector) == NULL) {
+		ra_queue[(ra_head + ra_cnt) % READAHEAD_QUEUE_SIZE] = sector;
+		ra_cnt++;
+		queued = true;
+	}
+	lock_release (&cache_lock);
+	if (queued)
+		sema_up (&ra_sema);
+}
+
+/* Read-ahead thread: loads the requested sectors that are still
+ * not cached.  They are not marked accessed, so they are the first
+ * to go again if nobody reads them. */
+static void
+cache_readahead_thread (void *aux UNUSED) {
+	for (;;) {
+		sema_down (&ra_sema);
+		lock_acquire (&cache_lock);
+		disk_sector_t sector = ra_queue[ra_head];
+		ra_head = (ra_head + 1) % READAHEAD_QUEUE_SIZE;
+		ra_cnt--;
+		if (cache_lookup (sector) == NULL) {
+			struct cache_entry *e = cache_evict ();
+			if (e != NULL && cache_lookup (sector) == NULL) { // 쫓아낼 entry가 없으면 기다리지 않고 요청을 버림
+				cache_load (e, sector, true);
+				cache_unpin (e);
+				stat_readaheads++;
+			}
+		}
+		lock_release (&cache_lock);
+	}
+}
+
+/* Write-behind thread: commits the journal and flushes the cache
+ * every CACHE_FLUSH_INTERVAL ticks, so that dirty data does not
+ * stay in memory only for long. */
+static void
+cache_flusher (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (CACHE_FLUSH_INTERVAL);
+		journal_commit ();
+		cache_flush ();
+	}
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void) {
+	printf ("Buffer cache: %lld hits, %lld misses, %lld writebacks, %lld read ahead\n",
+			stat_hits, stat_misses, stat_writebacks, stat_readaheads);
+}
@@ -1,10 +1,15 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
+#include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* A directory. */
 struct dir {
@@ -19,11 +24,179 @@ struct dir_entry {
 	bool in_use;                        /* In use or free? */
 };
 
+/* Directories with at most this many slots are searched from start
+ * to end.  Larger ones are hash tables. */
+#define DIR_LINEAR_MAX 64
+
+/* A new entry of a hashed directory goes at most this many slots
+ * after its home slot; otherwise the directory is doubled. */
+#define DIR_MAX_PROBE 16
+
+/* 큰 directory는 file 자체가 open addressing hash table임. 이름의 hash로 정한 home
+ * slot부터 차례로 보면서 찾고, 한번도 쓰인 적 없는 slot (inode_sector 가 0) 을
+ * 만나면 멈춤. 지운 entry는 in_use 만 끄고 inode_sector 는 남겨서 (tombstone) 그
+ * 뒤의 entry들을 계속 찾을 수 있게 함. 0번 sector는 free map inode라 entry가
+ * 가리킬 일이 없음. 작은 directory는 예전처럼 처음부터 끝까지 봄. */
+
+/* Maximum number of names kept in the dentry cache. */
+#define DCACHE_SIZE 256
+
+/* dentry cache: (directory inode sector, 이름) 으로 찾은 결과를 기억해서 같은 이름을
+ * 다시 찾을 때 directory를 읽지 않게 함. 없는 이름도 (negative) 기억하므로 create
+ * 전의 중복 검사도 disk를 읽지 않음. dir_add, dir_remove 가 항목을 고치고, entry
+ * 위치가 바뀌는 dir_rehash 는 그 directory의 항목을 모두 버림. 가장 오래 안 쓰인
+ * 항목부터 버림 (LRU).
+ *
+ * lookup 은 lock 없이 directory를 읽으므로 그 사이에 dir_add, dir_remove,
+ * dir_rehash 가 끝났을 수 있음. 그러면 읽은 결과는 이미 틀렸을 수 있으니, 이들이
+ * 올리는 dcache_gen 이 읽기 전과 같을 때만 기억함. */
+struct dentry {
+	disk_sector_t parent;               /* Sector of the directory's inode. */
+	char name[NAME_MAX + 1];            /* Null terminated file name. */
+	disk_sector_t inode_sector;         /* File's inode, 0 if NAME does not exist. */
+	off_t ofs;                          /* Offset of the entry in the directory. */
+	struct hash_elem hash_elem;         /* Element of dcache. */
+	struct list_elem lru_elem;          /* Element of dcache_lru. */
+};
+
+static struct hash dcache;              /* dentry들, (parent, name) 으로 찾음 */
+static struct list dcache_lru;          /* 최근에 쓴 것이 앞 */
+static size_t dcache_cnt;               /* dcache 의 항목 수 */
+static unsigned dcache_gen;             /* directory를 고칠 때마다 올림 */
+static struct lock dcache_lock;         /* 위의 것들을 모두 보호함 */
+
+/* Hashes a dentry by directory and name. */
+static uint64_t
+dentry_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+	return hash_string (d->name) ^ hash_int (d->parent);
+}
+
+/* Orders dentries by directory, then by name. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+	const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+	if (a->parent != b->parent)
+		return a->parent < b->parent;
+	return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the directory module. */
+void
+dir_init (void) {
+	hash_init (&dcache, dentry_hash, dentry_less, NULL);
+	list_init (&dcache_lru);
+	lock_init (&dcache_lock);
+}
+
+/* Returns the cached dentry for NAME in the directory whose inode is
+ * in PARENT, or a null pointer.  Must hold dcache_lock. */
+static struct dentry *
+dcache_find (disk_sector_t parent, const char *name) {
+	struct dentry key;
+	struct hash_elem *e;
+
+	key.parent = parent;
+	strlcpy (key.name, name, sizeof key.name);
+	e = hash_find (&dcache, &key.hash_elem);
+	return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Drops dentry D.  Must hold dcache_lock. */
+static void
+dcache_drop (struct dentry *d) {
+	hash_delete (&dcache, &d->hash_elem);
+	list_remove (&d->lru_elem);
+	dcache_cnt--;
+	free (d);
+}
+
+/* Remembers that NAME in the directory whose inode is in PARENT
+ * refers to the inode in INODE_SECTOR, stored at offset OFS, or does
+ * not exist if INODE_SECTOR is 0.  Must hold dcache_lock. */
+static void
+dcache_set (disk_sector_t parent, const char *name, disk_sector_t inode_sector,
+		off_t ofs) {
+	struct dentry *d = dcache_find (parent, name);
+
+	if (d == NULL) {
+		if (dcache_cnt == DCACHE_SIZE) // 가장 오래 안 쓰인 것을 버림
+			dcache_drop (list_entry (list_back (&dcache_lru), struct dentry, lru_elem));
+		d = malloc (sizeof *d);
+		if (d == NULL)
+			return;
+		d->parent = parent;
+		strlcpy (d->name, name, sizeof d->name);
+		hash_insert (&dcache, &d->hash_elem);
+		dcache_cnt++;
+	} else
+		list_remove (&d->lru_elem);
+	list_push_front (&dcache_lru, &d->lru_elem);
+	d->inode_sector = inode_sector;
+	d->ofs = ofs;
+}
+
+/* Like dcache_set(), for a change that has just been written to the
+ * directory.  Lookups that read the directory before it are not
+ * remembered. */
+static void
+dcache_put (disk_sector_t parent, const char *name, disk_sector_t inode_sector,
+		off_t ofs) {
+	lock_acquire (&dcache_lock);
+	dcache_gen++;
+	dcache_set (parent, name, inode_sector, ofs);
+	lock_release (&dcache_lock);
+}
+
+/* Like dcache_set(), for the result of a lookup that read the
+ * directory when dcache_gen was GEN.  Does nothing if a directory
+ * has changed since. */
+static void
+dcache_fill (disk_sector_t parent, const char *name, disk_sector_t inode_sector,
+		off_t ofs, unsigned gen) {
+	lock_acquire (&dcache_lock);
+	if (gen == dcache_gen)
+		dcache_set (parent, name, inode_sector, ofs);
+	lock_release (&dcache_lock);
+}
+
+/* Drops every cached name of the directory whose inode is in
+ * PARENT, after its entries have moved. */
+static void
+dcache_invalidate_dir (disk_sector_t parent) {
+	struct list_elem *e, *next;
+
+	lock_acquire (&dcache_lock);
+	dcache_gen++; // 옮기기 전의 offset을 읽은 lookup이 끝나도 기억하지 않게 함
+	for (e = list_begin (&dcache_lru); e != list_end (&dcache_lru); e = next) {
+		struct dentry *d = list_entry (e, struct dentry, lru_elem);
+		next = list_next (e);
+		if (d->parent == parent)
+			dcache_drop (d);
+	}
+	lock_release (&dcache_lock);
+}
+
+/* Returns the number of entry slots in directory inode INODE. */
+static size_t
+dir_capacity (struct inode *inode) {
+	return inode_length (inode) / sizeof (struct dir_entry);
+}
+
+/* Returns the home slot of NAME in a hashed directory with CAP
+ * slots. */
+static size_t
+dir_hash (const char *name, size_t cap) {
+	return hash_string (name) % cap;
+}
+
 /* Creates a directory with space for ENTRY_CNT entries in the
  * given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (disk_sector_t sector, size_t entry_cnt) {
-	return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+	return inode_create (sector, entry_cnt * sizeof (struct dir_entry), true);
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -32,6 +205,7 @@ struct dir *
 dir_open (struct inode *inode) {
 	struct dir *dir = calloc (1, sizeof *dir);
 	if (inode != NULL && dir != NULL) {
+		inode_set_meta (inode); // directory 내용은 journal을 거쳐서 씀
 		dir->inode = inode;
 		dir->pos = 0;
 		return dir;
@@ -75,18 +249,24 @@ dir_get_inode (struct dir *dir) {
  * If successful, returns true, sets *EP to the directory entry
  * if EP is non-null, and sets *OFSP to the byte offset of the
  * directory entry if OFSP is non-null.
- * otherwise, returns false and ignores EP and OFSP. */
+ * otherwise, returns false and ignores EP and OFSP.
+ * Reads the directory itself; see lookup(). */
 static bool
-lookup (const struct dir *dir, const char *name,
+lookup_disk (const struct dir *dir, const char *name,
 		struct dir_entry *ep, off_t *ofsp) {
 	struct dir_entry e;
-	size_t ofs;
+	size_t cap, slot, i;
 
 	ASSERT (dir != NULL);
 	ASSERT (name != NULL);
 
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
+	cap = dir_capacity (dir->inode);
+	slot = cap > DIR_LINEAR_MAX ? dir_hash (name, cap) : 0;
+	for (i = 0; i < cap; i++, slot = (slot + 1) % cap) {
+		off_t ofs = slot * sizeof e;
+
+		if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+			break;
 		if (e.in_use && !strcmp (name, e.name)) {
 			if (ep != NULL)
 				*ep = e;
@@ -94,9 +274,163 @@ lookup (const struct dir *dir, const char *name,
 				*ofsp = ofs;
 			return true;
 		}
+		if (cap > DIR_LINEAR_MAX && !e.in_use && e.inode_sector == 0) // 이 뒤에는 NAME이 있을 수 없음
+			break;
+	}
 	return false;
 }
 
+/* Like lookup_disk(), but answers from the dentry cache when it
+ * knows NAME, and remembers the answer otherwise. */
+static bool
+lookup (const struct dir *dir, const char *name,
+		struct dir_entry *ep, off_t *ofsp) {
+	disk_sector_t parent;
+	struct dir_entry e;
+	struct dentry *d;
+	unsigned gen;
+	off_t ofs;
+
+	ASSERT (dir != NULL);
+	ASSERT (name != NULL);
+
+	parent = inode_get_inumber (dir->inode);
+	if (strlen (name) > NAME_MAX) // 이런 이름의 entry는 있을 수 없음
+		return false;
+
+	lock_acquire (&dcache_lock);
+	d = dcache_find (parent, name);
+	if (d != NULL) {
+		bool found = d->inode_sector != 0;
+
+		list_remove (&d->lru_elem);
+		list_push_front (&dcache_lru, &d->lru_elem);
+		if (found) {
+			e.inode_sector = d->inode_sector;
+			strlcpy (e.name, name, sizeof e.name);
+			e.in_use = true;
+			if (ep != NULL)
+				*ep = e;
+			if (ofsp != NULL)
+				*ofsp = d->ofs;
+		}
+		lock_release (&dcache_lock);
+		return found;
+	}
+	gen = dcache_gen;
+	lock_release (&dcache_lock);
+
+	if (!lookup_disk (dir, name, &e, &ofs)) {
+		dcache_fill (parent, name, 0, 0, gen);
+		return false;
+	}
+	dcache_fill (parent, name, e.inode_sector, ofs, gen);
+	if (ep != NULL)
+		*ep = e;
+	if (ofsp != NULL)
+		*ofsp = ofs;
+	return true;
+}
+
+/* Finds a free slot for NAME in DIR and sets *OFSP to its offset.
+ * A small directory may get a new slot at its end.  Returns false if
+ * DIR has to be rehashed to make room. */
+static bool
+find_free_slot (const struct dir *dir, const char *name, off_t *ofsp) {
+	struct dir_entry e;
+	size_t cap = dir_capacity (dir->inode);
+	size_t slot, i;
+
+	if (cap <= DIR_LINEAR_MAX) {
+		for (slot = 0; slot < cap; slot++)
+			if (inode_read_at (dir->inode, &e, sizeof e, slot * sizeof e) == sizeof e
+					&& !e.in_use)
+				break;
+		if (slot == cap && cap == DIR_LINEAR_MAX)
+			return false;
+		*ofsp = slot * sizeof e; // 빈 slot이 없으면 file 끝에 붙임
+		return true;
+	}
+
+	slot = dir_hash (name, cap);
+	for (i = 0; i < DIR_MAX_PROBE; i++, slot = (slot + 1) % cap)
+		if (inode_read_at (dir->inode, &e, sizeof e, slot * sizeof e) == sizeof e
+				&& !e.in_use) {
+			*ofsp = slot * sizeof e;
+			return true;
+		}
+	return false;
+}
+
+/* Returns a new, empty inode that holds file data rather than
+ * metadata, or a null pointer if memory or disk space runs out. */
+static struct inode *
+dir_shadow_create (void) {
+	disk_sector_t sector = 0;
+	bool success;
+
+	journal_begin ();
+	success = free_map_allocate (1, &sector) && inode_create (sector, 0, false);
+	if (!success && sector != 0)
+		free_map_release (sector, 1);
+	journal_end ();
+	return success ? inode_open (sector) : NULL;
+}
+
+/* Doubles the number of slots of DIR, turning it into a hash table
+ * if it was searched linearly, and puts every entry at its new home
+ * slot.  Deleted entries are dropped.  Returns false, leaving DIR as
+ * it was, if memory or disk space runs out.
+ *
+ * 큰 directory의 table은 한 transaction에도, cache에도 다 들어가지 않으므로 새
+ * table은 제자리에 덮어쓰지 않고 따로 만든 inode (shadow) 에 다 써서 disk까지
+ * 내려보낸 뒤, 두 inode의 내용을 바꾸는 한 transaction으로 한번에 갈아끼움. 그
+ * 전에 disk가 차거나 전원이 나가도 옛 table은 그대로 남음. 갈아끼운 뒤 옛 table은
+ * shadow와 함께 지움. */
+static bool
+dir_rehash (struct dir *dir) {
+	size_t old_cap = dir_capacity (dir->inode);
+	size_t new_cap = old_cap * 2;
+	off_t old_size = old_cap * sizeof (struct dir_entry);
+	off_t new_size = new_cap * sizeof (struct dir_entry);
+	struct dir_entry *old = malloc (old_size);
+	struct dir_entry *new = calloc (new_cap, sizeof *new);
+	struct inode *shadow = NULL;
+	bool success = false;
+
+	ASSERT (new_cap > DIR_LINEAR_MAX);
+	if (old == NULL || new == NULL
+			|| inode_read_at (dir->inode, old, old_size, 0) != old_size)
+		goto done;
+
+	for (size_t i = 0; i < old_cap; i++)
+		if (old[i].in_use) {
+			size_t slot = dir_hash (old[i].name, new_cap);
+			while (new[slot].in_use)
+				slot = (slot + 1) % new_cap;
+			new[slot] = old[i];
+		}
+
+	shadow = dir_shadow_create ();
+	if (shadow == NULL)
+		goto done;
+	inode_remove (shadow); // 닫을 때 shadow가 들고 있는 table을 지움
+	if (inode_write_at (shadow, new, new_size, 0) != new_size) // disk가 차면 옛 table은 건드리지 않고 포기
+		goto done;
+	cache_flush (); // 새 table이 disk에 다 쓰인 뒤에야 갈아끼움
+	success = inode_swap (dir->inode, shadow);
+	if (success) {
+		dcache_invalidate_dir (inode_get_inumber (dir->inode)); // entry들의 위치가 바뀜
+		journal_commit (); // 옛 table의 sector들이 다른 file에 다시 쓰이기 전에 갈아끼운 것을 commit
+	}
+
+done:
+	inode_close (shadow);
+	free (old);
+	free (new);
+	return success;
+}
+
 /* Searches DIR for a file with the given NAME
  * and returns true if one exists, false otherwise.
  * On success, sets *INODE to an inode for the file, otherwise to
@@ -117,12 +451,27 @@ dir_lookup (const struct dir *dir, const char *name,
 	return *inode != NULL;
 }
 
+/* Makes sure DIR has a free slot for NAME, rehashing DIR if it has
+ * none.  A rehash takes several journal operations of its own, so
+ * this must be called before starting the operation that calls
+ * dir_add().  Returns false if memory or disk space runs out. */
+bool
+dir_make_room (struct dir *dir, const char *name) {
+	off_t ofs;
+
+	ASSERT (dir != NULL);
+	ASSERT (name != NULL);
+	return find_free_slot (dir, name, &ofs)
+	       || (dir_rehash (dir) && find_free_slot (dir, name, &ofs));
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
  * file by that name.  The file's inode is in sector
- * INODE_SECTOR.
+ * INODE_SECTOR.  DIR must have a free slot for NAME, see
+ * dir_make_room().
  * Returns true if successful, false on failure.
- * Fails if NAME is invalid (i.e. too long) or a disk or memory
- * error occurs. */
+ * Fails if NAME is invalid (i.e. too long), DIR is full or a disk or
+ * memory error occurs. */
 bool
 dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	struct dir_entry e;
@@ -140,23 +489,17 @@ dir_add (struct dir *dir, const char *name, disk_sector_t inode_sector) {
 	if (lookup (dir, name, NULL, NULL))
 		goto done;
 
-	/* Set OFS to offset of free slot.
-	 * If there are no free slots, then it will be set to the
-	 * current end-of-file.
-
-	 * inode_read_at() will only return a short read at end of file.
-	 * Otherwise, we'd need to verify that we didn't get a short
-	 * read due to something intermittent such as low memory. */
-	for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-			ofs += sizeof e)
-		if (!e.in_use)
-			break;
+	/* Set OFS to offset of free slot. */
+	if (!find_free_slot (dir, name, &ofs))
+		goto done;
 
 	/* Write slot. */
 	e.in_use = true;
 	strlcpy (e.name, name, sizeof e.name);
 	e.inode_sector = inode_sector;
 	success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+	if (success)
+		dcache_put (inode_get_inumber (dir->inode), name, inode_sector, ofs);
 
 done:
 	return success;
@@ -188,6 +531,7 @@ dir_remove (struct dir *dir, const char *name) {
 	e.in_use = false;
 	if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
 		goto done;
+	dcache_put (inode_get_inumber (dir->inode), name, 0, 0);
 
 	/* Remove inode. */
 	inode_remove (inode);
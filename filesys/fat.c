@@ -1,4 +1,6 @@
 #include "filesys/fat.h"
+#include <bitmap.h>
+#include <debug.h>
 #include "devices/disk.h"
 #include "filesys/filesys.h"
 #include "threads/malloc.h"
@@ -22,14 +24,16 @@ struct fat_fs {
 	unsigned int *fat;
 	unsigned int fat_length;
 	disk_sector_t data_start;
-	cluster_t last_clst;
-	struct lock write_lock;
+	cluster_t last_clst;              /* 다음 빈 cluster를 여기서부터 찾음 */
+	struct bitmap *free_map;          /* cluster 마다 bit 하나, 쓰는 중이면 true */
+	struct lock write_lock;           /* fat, free_map 과 last_clst 를 보호함 */
 };
 
 static struct fat_fs *fat_fs;
 
 void fat_boot_create (void);
 void fat_fs_init (void);
+static void fat_free_map_init (void);
 
 void
 fat_init (void) {
@@ -78,6 +82,7 @@ fat_open (void) {
 			free (bounce);
 		}
 	}
+	fat_free_map_init ();
 }
 
 void
@@ -123,6 +128,7 @@ fat_create (void) {
 	fat_fs->fat = calloc (fat_fs->fat_length, sizeof (cluster_t));
 	if (fat_fs->fat == NULL)
 		PANIC ("FAT creation failed");
+	fat_free_map_init ();
 
 	// Set up ROOT_DIR_CLST
 	fat_put (ROOT_DIR_CLUSTER, EOChain);
@@ -152,7 +158,47 @@ fat_boot_create (void) {
 
 void
 fat_fs_init (void) {
-	/* TODO: Your code goes here. */
+	fat_fs->data_start = fat_fs->bs.fat_start + fat_fs->bs.fat_sectors;
+	fat_fs->fat_length = (fat_fs->bs.total_sectors - fat_fs->data_start)
+	                     / SECTORS_PER_CLUSTER; // cluster 0은 쓰지 않으므로 마지막 cluster 하나는 남음
+	fat_fs->last_clst = ROOT_DIR_CLUSTER + 1;
+	lock_init (&fat_fs->write_lock);
+}
+
+/* Builds the free-cluster bitmap from the loaded FAT, so that
+ * allocation does not have to scan the FAT itself. */
+static void
+fat_free_map_init (void) {
+	fat_fs->free_map = bitmap_create (fat_fs->fat_length);
+	if (fat_fs->free_map == NULL)
+		PANIC ("FAT free map creation failed");
+	bitmap_mark (fat_fs->free_map, 0); // 0은 "cluster 없음" 이라 쓸 수 없음
+	for (cluster_t clst = 1; clst < fat_fs->fat_length; clst++)
+		if (fat_fs->fat[clst] != 0)
+			bitmap_mark (fat_fs->free_map, clst);
+}
+
+/* Returns a free cluster and marks it used, or 0 if the disk is
+ * full.  Takes NEAR if it is free, so that a chain being extended
+ * stays contiguous, and otherwise searches from the cluster after
+ * the last one handed out, wrapping around once.  Must hold
+ * write_lock. */
+static cluster_t
+fat_alloc_cluster (cluster_t near) {
+	size_t clst = BITMAP_ERROR;
+
+	if (near > 0 && near < fat_fs->fat_length && !bitmap_test (fat_fs->free_map, near)) {
+		bitmap_mark (fat_fs->free_map, near);
+		clst = near;
+	}
+	if (clst == BITMAP_ERROR)
+		clst = bitmap_scan_and_flip (fat_fs->free_map, fat_fs->last_clst, 1, false);
+	if (clst == BITMAP_ERROR)
+		clst = bitmap_scan_and_flip (fat_fs->free_map, 1, 1, false);
+	if (clst == BITMAP_ERROR)
+		return 0;
+	fat_fs->last_clst = clst + 1 < fat_fs->fat_length ? clst + 1 : 1;
+	return clst;
 }
 
 /*----------------------------------------------------------------------------*/
@@ -164,30 +210,81 @@ fat_fs_init (void) {
  * Returns 0 if fails to allocate a new cluster. */
 cluster_t
 fat_create_chain (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	cluster_t new_clst;
+
+	lock_acquire (&fat_fs->write_lock);
+	new_clst = fat_alloc_cluster (clst != 0 ? clst + 1 : 0); // 이어붙일 때는 바로 뒤 cluster가 비어있으면 그걸 씀
+	if (new_clst != 0) {
+		fat_fs->fat[new_clst] = EOChain;
+		if (clst != 0)
+			fat_fs->fat[clst] = new_clst;
+	}
+	lock_release (&fat_fs->write_lock);
+	return new_clst;
 }
 
 /* Remove the chain of clusters starting from CLST.
  * If PCLST is 0, assume CLST as the start of the chain. */
 void
 fat_remove_chain (cluster_t clst, cluster_t pclst) {
-	/* TODO: Your code goes here. */
+	lock_acquire (&fat_fs->write_lock);
+	if (pclst != 0)
+		fat_fs->fat[pclst] = EOChain;
+	while (clst != 0 && clst != EOChain) {
+		cluster_t next = fat_fs->fat[clst];
+
+		ASSERT (clst < fat_fs->fat_length);
+		fat_fs->fat[clst] = 0;
+		bitmap_reset (fat_fs->free_map, clst);
+		clst = next;
+	}
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Update a value in the FAT table. */
 void
 fat_put (cluster_t clst, cluster_t val) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	lock_acquire (&fat_fs->write_lock);
+	fat_fs->fat[clst] = val;
+	bitmap_set (fat_fs->free_map, clst, val != 0);
+	lock_release (&fat_fs->write_lock);
 }
 
 /* Fetch a value in the FAT table. */
 cluster_t
 fat_get (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->fat[clst];
+}
+
+/* Returns cluster number IDX of the chain starting at START, or 0 if
+ * the chain is shorter.  POS remembers the last cluster found, so
+ * that walking a chain in order follows one link per call instead
+ * of starting over from START.  A zeroed POS is valid. */
+cluster_t
+fat_seek (cluster_t start, size_t idx, struct fat_pos *pos) {
+	cluster_t clst = start;
+	size_t i = 0;
+
+	if (pos->start == start && pos->clst != 0 && pos->idx <= idx) { // 지난번 위치에서 이어서 감
+		clst = pos->clst;
+		i = pos->idx;
+	}
+	for (; i < idx && clst != 0 && clst != EOChain; i++)
+		clst = fat_get (clst);
+	if (clst == 0 || clst == EOChain)
+		return 0;
+
+	pos->start = start;
+	pos->idx = idx;
+	pos->clst = clst;
+	return clst;
 }
 
 /* Covert a cluster # to a sector number. */
 disk_sector_t
 cluster_to_sector (cluster_t clst) {
-	/* TODO: Your code goes here. */
+	ASSERT (clst > 0 && clst < fat_fs->fat_length);
+	return fat_fs->data_start + (clst - 1) * SECTORS_PER_CLUSTER;
 }
@@ -2,7 +2,13 @@
 #include <debug.h>
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "devices/disk.h"
 
+/* Bounds of the read-ahead window, in sectors.  The window starts
+ * small on the second sequential read and doubles with every
+ * further one. */
+#define RA_MIN_WINDOW 2
+#define RA_MAX_WINDOW 16
 
 
 /* Opens a file for the given INODE, of which it takes ownership,
@@ -15,6 +21,9 @@ file_open (struct inode *inode) {
 		file->inode = inode;
 		file->pos = 0;
 		file->deny_write = false;
+		file->ra_next = 0;
+		file->ra_end = 0;
+		file->ra_window = 0;
 		return file;
 	} else {
 		inode_close (inode);
@@ -59,6 +68,34 @@ file_get_inode (struct file *file) {
 	return file->inode;
 }
 
+/* Tracks reads of FILE and, while they are sequential, asks the
+ * buffer cache to read the sectors after the SIZE bytes at OFFSET in
+ * the background.  A read that does not continue the previous one
+ * resets the window. */
+static void
+file_readahead (struct file *file, off_t offset, off_t size) {
+	off_t end = offset + size;
+	off_t start, limit;
+
+	if (size <= 0)
+		return;
+	if (offset != file->ra_next) {
+		file->ra_window = 0;
+		file->ra_end = 0;
+	} else if (file->ra_window == 0)
+		file->ra_window = RA_MIN_WINDOW;
+	else if (file->ra_window < RA_MAX_WINDOW)
+		file->ra_window *= 2;
+	file->ra_next = end;
+	if (file->ra_window == 0)
+		return;
+
+	start = file->ra_end > end ? file->ra_end : end;
+	limit = end + (off_t) file->ra_window * DISK_SECTOR_SIZE;
+	if (start < limit)
+		file->ra_end = inode_readahead (file->inode, start, limit - start);
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
  * starting at the file's current position.
  * Returns the number of bytes actually read,
@@ -67,6 +104,7 @@ file_get_inode (struct file *file) {
 off_t
 file_read (struct file *file, void *buffer, off_t size) {
 	off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+	file_readahead (file, file->pos, bytes_read);
 	file->pos += bytes_read;
 	return bytes_read;
 }
@@ -78,15 +116,16 @@ file_read (struct file *file, void *buffer, off_t size) {
  * The file's current position is unaffected. */
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) {
-	return inode_read_at (file->inode, buffer, size, file_ofs);
+	off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+	file_readahead (file, file_ofs, bytes_read);
+	return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at the file's current position.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.  Writing
+ * past end of file grows the file.
  * Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) {
@@ -98,9 +137,8 @@ file_write (struct file *file, const void *buffer, off_t size) {
 /* Writes SIZE bytes from BUFFER into FILE,
  * starting at offset FILE_OFS in the file.
  * Returns the number of bytes actually written,
- * which may be less than SIZE if end of file is reached.
- * (Normally we'd grow the file in that case, but file growth is
- * not yet implemented.)
+ * which may be less than SIZE if the disk is full.  Writing
+ * past end of file grows the file.
  * The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -2,9 +2,11 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
 #include "devices/disk.h"
 
@@ -21,7 +23,9 @@ filesys_init (bool format) {
 	if (filesys_disk == NULL)
 		PANIC ("hd0:1 (hdb) not present, file system initialization failed");
 
+	cache_init ();
 	inode_init ();
+	dir_init ();
 
 #ifdef EFILESYS
 	fat_init ();
@@ -33,6 +37,7 @@ filesys_init (bool format) {
 #else
 	/* Original FS */
 	free_map_init ();
+	journal_init (format);
 
 	if (format)
 		do_format ();
@@ -51,6 +56,8 @@ filesys_done (void) {
 #else
 	free_map_close ();
 #endif
+	journal_commit ();
+	cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -60,13 +67,33 @@ filesys_done (void) {
 bool
 filesys_create (const char *name, off_t initial_size) {
 	disk_sector_t inode_sector = 0;
-	struct dir *dir = dir_open_root ();
-	bool success = (dir != NULL
+	struct dir *dir;
+	bool success;
+
+	dir = dir_open_root ();
+	success = dir != NULL && dir_make_room (dir, name); // 큰 directory의 rehash는 작업 하나에 다 들어가지 않으니 먼저 함
+	journal_begin ();
+	success = (success
 			&& free_map_allocate (1, &inode_sector)
-			&& inode_create (inode_sector, initial_size)
+			&& inode_create (inode_sector, 0, false)
 			&& dir_add (dir, name, inode_sector));
 	if (!success && inode_sector != 0)
 		free_map_release (inode_sector, 1);
+	journal_end ();
+
+	/* Grow the new file afterwards, since a large file does not fit
+	 * in one journal operation. */
+	if (success && initial_size > 0) {
+		struct inode *inode = inode_open (inode_sector);
+
+		success = inode != NULL && inode_extend (inode, initial_size) == initial_size;
+		if (!success) {
+			journal_begin ();
+			dir_remove (dir, name);
+			journal_end ();
+		}
+		inode_close (inode); // 지웠다면 sector들은 여기서 돌려줌
+	}
 	dir_close (dir);
 
 	return success;
@@ -95,8 +122,17 @@ filesys_open (const char *name) {
  * or if an internal memory allocation fails. */
 bool
 filesys_remove (const char *name) {
-	struct dir *dir = dir_open_root ();
-	bool success = dir != NULL && dir_remove (dir, name);
+	struct dir *dir;
+	struct inode *inode = NULL;
+	bool success;
+
+	dir = dir_open_root ();
+	if (dir != NULL)
+		dir_lookup (dir, name, &inode); // 열어둔 채로 지워야 sector들을 작업이 끝난 뒤에 돌려줌
+	journal_begin ();
+	success = dir != NULL && dir_remove (dir, name);
+	journal_end ();
+	inode_close (inode); // 마지막으로 닫는 것이면 여러 작업에 나눠서 sector들을 돌려줌
 	dir_close (dir);
 
 	return success;
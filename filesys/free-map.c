@@ -4,10 +4,27 @@
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per disk sector. */
 
+/* Number of sectors whose bits share one sector of the free map
+ * file. */
+#define SECTORS_PER_CHUNK (DISK_SECTOR_SIZE * 8)
+
+/* Writes the sectors of the free map file that hold the bits of the
+ * CNT sectors starting at SECTOR.  Flipping a few bits then costs a
+ * single buffer cache write instead of rewriting the whole map. */
+static bool
+free_map_write (disk_sector_t sector, size_t cnt) {
+	size_t first = sector / SECTORS_PER_CHUNK;
+	size_t last = (sector + cnt - 1) / SECTORS_PER_CHUNK;
+
+	return bitmap_write_part (free_map, free_map_file, first * DISK_SECTOR_SIZE,
+			(last - first + 1) * DISK_SECTOR_SIZE);
+}
+
 /* Initializes the free map. */
 void
 free_map_init (void) {
@@ -16,6 +33,7 @@ free_map_init (void) {
 		PANIC ("bitmap creation failed--disk is too large");
 	bitmap_mark (free_map, FREE_MAP_SECTOR);
 	bitmap_mark (free_map, ROOT_DIR_SECTOR);
+	bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_SLOTS + 1, true);
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -24,10 +42,23 @@ free_map_init (void) {
  * available. */
 bool
 free_map_allocate (size_t cnt, disk_sector_t *sectorp) {
-	disk_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+	return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* Like free_map_allocate(), but takes the first run of CNT free
+ * sectors at or after NEAR, so that a growing file can continue
+ * right after its last sector.  Falls back to the first run on the
+ * disk if there is none after NEAR. */
+bool
+free_map_allocate_near (size_t cnt, disk_sector_t near, disk_sector_t *sectorp) {
+	disk_sector_t sector = BITMAP_ERROR;
+	if (near < bitmap_size (free_map))
+		sector = bitmap_scan_and_flip (free_map, near, cnt, false);
+	if (sector == BITMAP_ERROR && near != 0)
+		sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
 	if (sector != BITMAP_ERROR
 			&& free_map_file != NULL
-			&& !bitmap_write (free_map, free_map_file)) {
+			&& !free_map_write (sector, cnt)) {
 		bitmap_set_multiple (free_map, sector, cnt, false);
 		sector = BITMAP_ERROR;
 	}
@@ -41,7 +72,7 @@ void
 free_map_release (disk_sector_t sector, size_t cnt) {
 	ASSERT (bitmap_all (free_map, sector, cnt));
 	bitmap_set_multiple (free_map, sector, cnt, false);
-	bitmap_write (free_map, free_map_file);
+	free_map_write (sector, cnt);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -50,6 +81,7 @@ free_map_open (void) {
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
 	if (free_map_file == NULL)
 		PANIC ("can't open free map");
+	inode_set_meta (file_get_inode (free_map_file));
 	if (!bitmap_read (free_map, free_map_file))
 		PANIC ("can't read free map");
 }
@@ -65,13 +97,14 @@ free_map_close (void) {
 void
 free_map_create (void) {
 	/* Create inode. */
-	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+	if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), true))
 		PANIC ("free map creation failed");
 
 	/* Write bitmap to file. */
 	free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
 	if (free_map_file == NULL)
 		PANIC ("can't open free map");
+	inode_set_meta (file_get_inode (free_map_file));
 	if (!bitmap_write (free_map, free_map_file))
 		PANIC ("can't write free map");
 }
@@ -1,22 +1,52 @@
 #include "filesys/inode.h"
+#include <hash.h>
 #include <list.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of closed inodes kept in memory for a quick reopen. */
+#define CLOSED_INODES_MAX 32
+
+/* Number of data sectors an inode points to directly. */
+#define DIRECT_CNT 124
+
+/* Number of sector numbers in an indirect block. */
+#define INDIRECT_CNT (DISK_SECTOR_SIZE / sizeof (disk_sector_t))
+
+/* Largest file, in sectors: direct, indirect and doubly indirect
+ * blocks. */
+#define MAX_SECTORS (DIRECT_CNT + INDIRECT_CNT + INDIRECT_CNT * INDIRECT_CNT)
+
+/* Journal slots a run of at most INDIRECT_CNT new sectors needs,
+ * besides the sectors themselves if they are zeroed through the
+ * journal: two free map sectors, three indirect blocks and the
+ * inode. */
+#define EXTEND_RUN_SLOTS 6
+
 /* On-disk inode.
- * Must be exactly DISK_SECTOR_SIZE bytes long. */
+ * Must be exactly DISK_SECTOR_SIZE bytes long.
+ *
+ * 데이터 sector들을 연속으로 잡지 않고 sector 번호를 직접 들고 있음. 앞의
+ * DIRECT_CNT 개는 inode 안에, 그 다음은 indirect block (sector 번호 128개) 하나,
+ * 나머지는 doubly indirect block 에서 찾으므로 어느 offset이든 많아야 sector
+ * 두개를 더 읽으면 됨. 0은 아직 잡지 않은 sector (0번은 free map inode라서 데이터로
+ * 쓰일 일이 없음). */
 struct inode_disk {
-	disk_sector_t start;                /* First data sector. */
+	disk_sector_t direct[DIRECT_CNT];   /* Data sectors. */
+	disk_sector_t indirect;             /* Sector of the next INDIRECT_CNT data sectors. */
+	disk_sector_t doubly_indirect;      /* Sector of indirect blocks for the rest. */
 	off_t length;                       /* File size in bytes. */
 	unsigned magic;                     /* Magic number. */
-	uint32_t unused[125];               /* Not used. */
 };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,14 +58,46 @@ bytes_to_sectors (off_t size) {
 
 /* In-memory inode. */
 struct inode {
-	struct list_elem elem;              /* Element in inode list. */
+	struct hash_elem elem;              /* Element in open_inodes. */
+	struct list_elem closed_elem;       /* Element in closed_inodes if open_cnt is 0. */
 	disk_sector_t sector;               /* Sector number of disk location. */
 	int open_cnt;                       /* Number of openers. */
 	bool removed;                       /* True if deleted, false otherwise. */
 	int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+	struct lock extend_lock;            /* 파일을 늘리는 writer는 한번에 하나만 */
+	bool meta;                          /* directory나 free map 처럼 내용도 journal에 기록함 */
+	bool loading;                       /* data를 disk에서 읽는 중이면 true, 다 읽을 때까지 쓰면 안됨 */
 	struct inode_disk data;             /* Inode content. */
 };
 
+/* Returns entry IDX of the indirect block in SECTOR, or 0 if
+ * SECTOR has not been allocated. */
+static disk_sector_t
+indirect_get (disk_sector_t sector, size_t idx) {
+	disk_sector_t entry;
+
+	if (sector == 0)
+		return 0;
+	cache_read (sector, &entry, idx * sizeof entry, sizeof entry);
+	return entry;
+}
+
+/* Returns the data sector IDX of DISK_INODE, or 0 if it has not been
+ * allocated. */
+static disk_sector_t
+index_to_sector (const struct inode_disk *disk_inode, size_t idx) {
+	if (idx < DIRECT_CNT)
+		return disk_inode->direct[idx];
+	idx -= DIRECT_CNT;
+	if (idx < INDIRECT_CNT)
+		return indirect_get (disk_inode->indirect, idx);
+	idx -= INDIRECT_CNT;
+	if (idx < INDIRECT_CNT * INDIRECT_CNT)
+		return indirect_get (indirect_get (disk_inode->doubly_indirect, idx / INDIRECT_CNT),
+				idx % INDIRECT_CNT);
+	return 0;
+}
+
 /* Returns the disk sector that contains byte offset POS within
  * INODE.
  * Returns -1 if INODE does not contain data for a byte at offset
@@ -44,28 +106,224 @@ static disk_sector_t
 byte_to_sector (const struct inode *inode, off_t pos) {
 	ASSERT (inode != NULL);
 	if (pos < inode->data.length)
-		return inode->data.start + pos / DISK_SECTOR_SIZE;
+		return index_to_sector (&inode->data, pos / DISK_SECTOR_SIZE);
 	else
 		return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
- * returns the same `struct inode'. */
-static struct list open_inodes;
+/* A sector full of zeros. */
+static char zeros[DISK_SECTOR_SIZE];
+
+/* Makes sure *SECTORP names an allocated sector, allocating a zeroed
+ * one if it is 0.  Returns false if the disk is full. */
+static bool
+sector_alloc (disk_sector_t *sectorp) {
+	if (*sectorp != 0)
+		return true;
+	if (!free_map_allocate (1, sectorp))
+		return false;
+	cache_write_meta (*sectorp, zeros, 0, DISK_SECTOR_SIZE);
+	return true;
+}
+
+/* Makes sure entry IDX of the indirect block in SECTOR is allocated
+ * and stores it into *ENTRYP.  Returns false if the disk is full. */
+static bool
+indirect_alloc (disk_sector_t sector, size_t idx, disk_sector_t *entryp) {
+	disk_sector_t entry = indirect_get (sector, idx);
+
+	if (entry == 0) {
+		if (!sector_alloc (&entry))
+			return false;
+		cache_write_meta (sector, &entry, idx * sizeof entry, sizeof entry);
+	}
+	*entryp = entry;
+	return true;
+}
+
+/* Stores SECTOR as data sector IDX of DISK_INODE, allocating the
+ * indirect blocks leading to it if needed. */
+static bool
+index_set (struct inode_disk *disk_inode, size_t idx, disk_sector_t sector) {
+	disk_sector_t indirect;
+
+	if (idx < DIRECT_CNT) {
+		disk_inode->direct[idx] = sector;
+		return true;
+	}
+	idx -= DIRECT_CNT;
+	if (idx < INDIRECT_CNT)
+		indirect = disk_inode->indirect;
+	else {
+		idx -= INDIRECT_CNT;
+		if (!sector_alloc (&disk_inode->doubly_indirect)
+				|| !indirect_alloc (disk_inode->doubly_indirect, idx / INDIRECT_CNT, &indirect))
+			return false;
+		idx %= INDIRECT_CNT;
+	}
+	if (indirect == 0) {
+		if (!sector_alloc (&disk_inode->indirect))
+			return false;
+		indirect = disk_inode->indirect;
+	}
+	cache_write_meta (indirect, &sector, idx * sizeof sector, sizeof sector);
+	return true;
+}
+
+/* Allocates the sectors DISK_INODE needs to hold LENGTH bytes.  Does
+ * not change its length.  The new sectors are zeroed through the
+ * journal if META is true.  Returns false if LENGTH is too large or
+ * the disk is full; the sectors allocated so far stay with the
+ * inode.  Also stops early, returning true, once the running journal
+ * operation has no room for another run of sectors; see
+ * inode_disk_mapped_length() for how far it got.
+ *
+ * 새 sector들은 한번에 연속으로, 파일의 마지막 sector 바로 뒤부터 잡으려고 함. 그래야
+ * 조금씩 늘려가며 쓰는 파일도 disk에서 이어져 있게 되어 나중에 순차로 읽을 때 seek가
+ * 적음. 그만큼 연속된 자리가 없으면 반씩 줄여가며 잡음. */
+static bool
+inode_disk_extend (struct inode_disk *disk_inode, off_t length, bool meta) {
+	size_t sectors = bytes_to_sectors (length);
+	size_t i = bytes_to_sectors (disk_inode->length);
+	disk_sector_t near = i > 0 ? index_to_sector (disk_inode, i - 1) + 1 : 0;
+
+	if (sectors > MAX_SECTORS)
+		return false;
+	while (i < sectors) {
+		disk_sector_t start, mapped = index_to_sector (disk_inode, i);
+		size_t cnt = sectors - i;
+
+		if (mapped != 0) { // 지난번에 실패한 확장이 이미 잡아둔 sector
+			near = mapped + 1;
+			i++;
+			continue;
+		}
+		size_t room = journal_room ();
+		if (room < EXTEND_RUN_SLOTS + (size_t) meta) // 이 작업의 journal 예약을 다 씀, 나머지는 다음 작업에서
+			return true;
+		if (cnt > INDIRECT_CNT) // index block을 셋 넘게 건드리지 않게 함
+			cnt = INDIRECT_CNT;
+		if (meta && cnt > room - EXTEND_RUN_SLOTS)
+			cnt = room - EXTEND_RUN_SLOTS;
+		while (!free_map_allocate_near (cnt, near, &start))
+			if ((cnt /= 2) == 0)
+				return false;
+		for (size_t k = 0; k < cnt; k++, i++) {
+			if (meta) // metadata가 가리키기 전에 0으로 채워진 게 journal에 남아야 함
+				cache_write_meta (start + k, zeros, 0, DISK_SECTOR_SIZE);
+			else
+				cache_write (start + k, zeros, 0, DISK_SECTOR_SIZE);
+			if (!index_set (disk_inode, i, start + k)) {
+				free_map_release (start + k, cnt - k);
+				return false;
+			}
+		}
+		near = start + cnt;
+	}
+	return true;
+}
+
+/* Returns how far DISK_INODE can grow toward LENGTH bytes with the
+ * sectors it already has, such as those a failed inode_disk_extend()
+ * allocated. */
+static off_t
+inode_disk_mapped_length (const struct inode_disk *disk_inode, off_t length) {
+	size_t i = bytes_to_sectors (disk_inode->length);
+
+	while (i < bytes_to_sectors (length) && index_to_sector (disk_inode, i) != 0)
+		i++;
+	if ((off_t) i * DISK_SECTOR_SIZE < length)
+		length = (off_t) i * DISK_SECTOR_SIZE;
+	return length > disk_inode->length ? length : disk_inode->length;
+}
+
+/* Frees SECTOR, a sector of an inode that is being deleted and that
+ * nobody can reach any more.  Moves on to a new journal operation
+ * first if the running one has no room for the free map sector this
+ * changes: stopping anywhere while freeing such an inode leaves the
+ * file system consistent, only with some sectors leaked. */
+static void
+release_sector (disk_sector_t sector) {
+	if (journal_room () == 0)
+		journal_restart ();
+	free_map_release (sector, 1);
+}
+
+/* Releases SECTOR, which is an indirect block pointing DEPTH levels
+ * down to data sectors if DEPTH > 0, together with everything it
+ * points to. */
+static void
+indirect_release (disk_sector_t sector, int depth) {
+	if (sector == 0)
+		return;
+	if (depth > 0) {
+		disk_sector_t *entries = malloc (DISK_SECTOR_SIZE);
+		if (entries != NULL) {
+			cache_read (sector, entries, 0, DISK_SECTOR_SIZE);
+			for (size_t i = 0; i < INDIRECT_CNT; i++)
+				indirect_release (entries[i], depth - 1);
+			free (entries);
+		}
+	}
+	release_sector (sector);
+}
+
+/* Releases every sector DISK_INODE points to. */
+static void
+inode_disk_release (struct inode_disk *disk_inode) {
+	for (size_t i = 0; i < DIRECT_CNT; i++)
+		indirect_release (disk_inode->direct[i], 0);
+	indirect_release (disk_inode->indirect, 1);
+	indirect_release (disk_inode->doubly_indirect, 2);
+}
+
+/* Open inodes by sector, so that opening a single inode twice
+ * returns the same `struct inode'.  Also holds the recently closed
+ * inodes in closed_inodes, so that reopening one does not read its
+ * sector again. */
+static struct hash open_inodes;
+
+/* 마지막 opener가 닫았지만 지우지 않은 inode들, 최근에 닫은 것이 앞.
+ * CLOSED_INODES_MAX 개를 넘으면 가장 오래된 것부터 free 함. */
+static struct list closed_inodes;
+static size_t closed_cnt;
+
+/* open_inodes, closed_inodes 와 open_cnt, loading 을 보호함 */
+static struct lock open_inodes_lock;
+
+/* loading 이 끝날 때마다 알림 */
+static struct condition inode_loaded;
+
+/* Hashes an inode by its sector. */
+static uint64_t
+inode_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Orders inodes by sector. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b, void *aux UNUSED) {
+	return hash_entry (a, struct inode, elem)->sector
+	       < hash_entry (b, struct inode, elem)->sector;
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) {
-	list_init (&open_inodes);
+	hash_init (&open_inodes, inode_hash, inode_less, NULL);
+	list_init (&closed_inodes);
+	lock_init (&open_inodes_lock);
+	cond_init (&inode_loaded);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
  * writes the new inode to sector SECTOR on the file system
- * disk.
+ * disk.  META tells whether the inode will hold metadata, whose
+ * initial zeros must go through the journal.
  * Returns true if successful.
  * Returns false if memory or disk allocation fails. */
 bool
-inode_create (disk_sector_t sector, off_t length) {
+inode_create (disk_sector_t sector, off_t length, bool meta) {
 	struct inode_disk *disk_inode = NULL;
 	bool success = false;
 
@@ -77,20 +335,14 @@ inode_create (disk_sector_t sector, off_t length) {
 
 	disk_inode = calloc (1, sizeof *disk_inode);
 	if (disk_inode != NULL) {
-		size_t sectors = bytes_to_sectors (length);
-		disk_inode->length = length;
 		disk_inode->magic = INODE_MAGIC;
-		if (free_map_allocate (sectors, &disk_inode->start)) {
-			disk_write (filesys_disk, sector, disk_inode);
-			if (sectors > 0) {
-				static char zeros[DISK_SECTOR_SIZE];
-				size_t i;
-
-				for (i = 0; i < sectors; i++) 
-					disk_write (filesys_disk, disk_inode->start + i, zeros); 
-			}
+		if (inode_disk_extend (disk_inode, length, meta)
+				&& inode_disk_mapped_length (disk_inode, length) == length) {
+			disk_inode->length = length;
+			cache_write_meta (sector, disk_inode, 0, DISK_SECTOR_SIZE);
 			success = true; 
-		} 
+		} else
+			inode_disk_release (disk_inode);
 		free (disk_inode);
 	}
 	return success;
@@ -101,39 +353,63 @@ inode_create (disk_sector_t sector, off_t length) {
  * Returns a null pointer if memory allocation fails. */
 struct inode *
 inode_open (disk_sector_t sector) {
-	struct list_elem *e;
+	struct inode key;
+	struct hash_elem *e;
 	struct inode *inode;
 
-	/* Check whether this inode is already open. */
-	for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-			e = list_next (e)) {
-		inode = list_entry (e, struct inode, elem);
-		if (inode->sector == sector) {
-			inode_reopen (inode);
-			return inode; 
+	/* Check whether this inode is already open or was closed
+	 * recently. */
+	lock_acquire (&open_inodes_lock);
+	key.sector = sector;
+	e = hash_find (&open_inodes, &key.elem);
+	if (e != NULL) {
+		inode = hash_entry (e, struct inode, elem);
+		if (inode->open_cnt++ == 0) { // 닫혀 있던 inode를 다시 씀
+			list_remove (&inode->closed_elem);
+			closed_cnt--;
 		}
+		while (inode->loading) // 먼저 연 thread가 아직 읽고 있음
+			cond_wait (&inode_loaded, &open_inodes_lock);
+		lock_release (&open_inodes_lock);
+		return inode;
 	}
 
 	/* Allocate memory. */
 	inode = malloc (sizeof *inode);
-	if (inode == NULL)
+	if (inode == NULL) {
+		lock_release (&open_inodes_lock);
 		return NULL;
+	}
 
-	/* Initialize. */
-	list_push_front (&open_inodes, &inode->elem);
+	/* Initialize.  The sector is read with the lock released; the
+	 * inode is marked loading meanwhile, so that others opening it
+	 * wait until it is filled in. */
 	inode->sector = sector;
+	hash_insert (&open_inodes, &inode->elem);
 	inode->open_cnt = 1;
 	inode->deny_write_cnt = 0;
 	inode->removed = false;
-	disk_read (filesys_disk, inode->sector, &inode->data);
+	lock_init (&inode->extend_lock);
+	inode->meta = false;
+	inode->loading = true;
+	lock_release (&open_inodes_lock); // 읽는 동안 다른 inode의 open, close는 막지 않음
+	cache_read (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE);
+
+	lock_acquire (&open_inodes_lock);
+	inode->loading = false;
+	cond_broadcast (&inode_loaded, &open_inodes_lock);
+	lock_release (&open_inodes_lock);
 	return inode;
 }
 
 /* Reopens and returns INODE. */
 struct inode *
 inode_reopen (struct inode *inode) {
-	if (inode != NULL)
+	if (inode != NULL) {
+		lock_acquire (&open_inodes_lock);
 		inode->open_cnt++;
+		lock_release (&open_inodes_lock);
+	}
 	return inode;
 }
 
@@ -144,7 +420,8 @@ inode_get_inumber (const struct inode *inode) {
 }
 
 /* Closes INODE and writes it to disk.
- * If this was the last reference to INODE, frees its memory.
+ * If this was the last reference to INODE, keeps it among the
+ * recently closed inodes, or frees its memory if it was removed.
  * If INODE was also a removed inode, frees its blocks. */
 void
 inode_close (struct inode *inode) {
@@ -153,19 +430,72 @@ inode_close (struct inode *inode) {
 		return;
 
 	/* Release resources if this was the last opener. */
-	if (--inode->open_cnt == 0) {
-		/* Remove from inode list and release lock. */
-		list_remove (&inode->elem);
-
-		/* Deallocate blocks if removed. */
-		if (inode->removed) {
-			free_map_release (inode->sector, 1);
-			free_map_release (inode->data.start,
-					bytes_to_sectors (inode->data.length)); 
+	lock_acquire (&open_inodes_lock);
+	if (--inode->open_cnt > 0) {
+		lock_release (&open_inodes_lock);
+		return;
+	}
+
+	/* Keep the inode around if it is still on disk, dropping the
+	 * oldest closed inode if there are too many. */
+	if (!inode->removed) {
+		list_push_front (&closed_inodes, &inode->closed_elem);
+		if (++closed_cnt <= CLOSED_INODES_MAX) {
+			lock_release (&open_inodes_lock);
+			return;
 		}
+		inode = list_entry (list_pop_back (&closed_inodes), struct inode, closed_elem);
+		closed_cnt--;
+	}
 
-		free (inode); 
+	/* Remove from inode table and release lock. */
+	hash_delete (&open_inodes, &inode->elem);
+	lock_release (&open_inodes_lock);
+
+	/* Deallocate blocks if removed, in as many journal operations
+	 * as it takes. */
+	if (inode->removed) {
+		journal_begin ();
+		release_sector (inode->sector);
+		inode_disk_release (&inode->data);
+		journal_end ();
 	}
+
+	free (inode); 
+}
+
+/* Marks INODE as holding file system metadata, such as a directory,
+ * so that writes to its contents go through the journal. */
+void
+inode_set_meta (struct inode *inode) {
+	ASSERT (inode != NULL);
+	inode->meta = true;
+}
+
+/* Exchanges the data of A and B, so that each points to the sectors
+ * the other one had, and writes both inodes as one journal
+ * operation.  A table built out of place in B thus replaces the
+ * contents of A at once, and closing B after removing it frees the
+ * old contents.  Returns false if memory runs out. */
+bool
+inode_swap (struct inode *a, struct inode *b) {
+	struct inode_disk *tmp = malloc (sizeof *tmp);
+
+	if (tmp == NULL)
+		return false;
+	journal_begin ();
+	lock_acquire (&a->extend_lock);
+	lock_acquire (&b->extend_lock);
+	*tmp = a->data;
+	a->data = b->data;
+	b->data = *tmp;
+	cache_write_meta (a->sector, &a->data, 0, DISK_SECTOR_SIZE);
+	cache_write_meta (b->sector, &b->data, 0, DISK_SECTOR_SIZE);
+	lock_release (&b->extend_lock);
+	lock_release (&a->extend_lock);
+	journal_end ();
+	free (tmp);
+	return true;
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -183,7 +513,6 @@ off_t
 inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 	uint8_t *buffer = buffer_;
 	off_t bytes_read = 0;
-	uint8_t *bounce = NULL;
 
 	while (size > 0) {
 		/* Disk sector to read, starting byte offset within sector. */
@@ -200,46 +529,53 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) {
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Read full sector directly into caller's buffer. */
-			disk_read (filesys_disk, sector_idx, buffer + bytes_read); 
-		} else {
-			/* Read sector into bounce buffer, then partially copy
-			 * into caller's buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-			disk_read (filesys_disk, sector_idx, bounce);
-			memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-		}
+		/* Copy the chunk out of the buffer cache, which reads the
+		 * sector from disk only if it is not cached yet. */
+		cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_read += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_read;
 }
 
+/* Asks the buffer cache to read the sectors of INODE that hold the
+ * LENGTH bytes starting at OFFSET in the background.  Stops at the
+ * end of the file.  Returns the offset up to which read-ahead was
+ * requested. */
+off_t
+inode_readahead (struct inode *inode, off_t offset, off_t length) {
+	off_t end = offset + length;
+
+	if (end > inode_length (inode))
+		end = inode_length (inode);
+	offset = ROUND_DOWN (offset, DISK_SECTOR_SIZE);
+	for (; offset < end; offset += DISK_SECTOR_SIZE)
+		cache_readahead (byte_to_sector (inode, offset));
+	return offset > end ? offset : end;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
  * Returns the number of bytes actually written, which may be
- * less than SIZE if end of file is reached or an error occurs.
- * (Normally a write at end of file would extend the inode, but
- * growth is not yet implemented.) */
+ * less than SIZE if an error occurs.  A write past end of file
+ * extends the inode, filling any gap with zeros.  If the disk fills
+ * up, the inode is extended over the sectors that could be allocated
+ * and the write stops there. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		off_t offset) {
 	const uint8_t *buffer = buffer_;
 	off_t bytes_written = 0;
-	uint8_t *bounce = NULL;
 
 	if (inode->deny_write_cnt)
 		return 0;
 
+	if (offset + size > inode_length (inode))
+		inode_extend (inode, offset + size); // 다 늘리지 못하면 늘린 데까지만 씀
+
 	while (size > 0) {
 		/* Sector to write, starting byte offset within sector. */
 		disk_sector_t sector_idx = byte_to_sector (inode, offset);
@@ -255,38 +591,54 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 		if (chunk_size <= 0)
 			break;
 
-		if (sector_ofs == 0 && chunk_size == DISK_SECTOR_SIZE) {
-			/* Write full sector directly to disk. */
-			disk_write (filesys_disk, sector_idx, buffer + bytes_written); 
-		} else {
-			/* We need a bounce buffer. */
-			if (bounce == NULL) {
-				bounce = malloc (DISK_SECTOR_SIZE);
-				if (bounce == NULL)
-					break;
-			}
-
-			/* If the sector contains data before or after the chunk
-			   we're writing, then we need to read in the sector
-			   first.  Otherwise we start with a sector of all zeros. */
-			if (sector_ofs > 0 || chunk_size < sector_left) 
-				disk_read (filesys_disk, sector_idx, bounce);
-			else
-				memset (bounce, 0, DISK_SECTOR_SIZE);
-			memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-			disk_write (filesys_disk, sector_idx, bounce); 
-		}
+		/* Write the chunk into the buffer cache.  A partially
+		 * written sector is read in first; the cache writes it
+		 * back to disk later. */
+		if (inode->meta)
+			cache_write_meta (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
+		else
+			cache_write (sector_idx, buffer + bytes_written, sector_ofs, chunk_size);
 
 		/* Advance. */
 		size -= chunk_size;
 		offset += chunk_size;
 		bytes_written += chunk_size;
 	}
-	free (bounce);
 
 	return bytes_written;
 }
 
+/* Grows INODE to LENGTH bytes, filling the new part with zeros, and
+ * returns its new length.  If the disk fills up, INODE grows over
+ * the sectors that could be allocated.  A large extension is done in
+ * several journal operations, each leaving INODE somewhat longer,
+ * unless it is part of an enclosing operation, which then bounds how
+ * far INODE can grow. */
+off_t
+inode_extend (struct inode *inode, off_t length) {
+	journal_begin ();
+	lock_acquire (&inode->extend_lock);
+	while (length > inode_length (inode)) {
+		bool success = inode_disk_extend (&inode->data, length, inode->meta);
+		off_t mapped = inode_disk_mapped_length (&inode->data, length);
+		bool restarted;
+
+		inode->data.length = mapped; // sector를 다 잡은 뒤에 늘려야 reader가 빈 sector를 보지 않음
+		cache_write_meta (inode->sector, &inode->data, 0, DISK_SECTOR_SIZE); // 실패해도 새로 잡은 sector들이 reboot 뒤에 새지 않게 씀
+		if (!success || mapped == length)
+			break;
+		lock_release (&inode->extend_lock); // 다음 작업의 예약을 기다리는 동안 이 inode를 쓰려는 작업을 막지 않음
+		restarted = journal_restart ();
+		lock_acquire (&inode->extend_lock);
+		if (!restarted)
+			break;
+	}
+	length = inode_length (inode);
+	lock_release (&inode->extend_lock);
+	journal_end ();
+	return length;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 	void
@@ -0,0 +1,221 @@
+/* journal.c: Write-ahead journal for file system metadata.
+ *
+ * inode, index block, directory와 free map의 내용 같은 metadata sector는 buffer
+ * cache에서 바로 disk에 쓰이지 않고 transaction에 모였다가 commit 때 journal
+ * 영역에 순서대로 기록됨 (cache_commit). header sector에 그 sector 번호들을 쓰는
+ * 순간이 commit 지점이고, 제자리에는 그 뒤에 write-behind가 천천히 씀
+ * (checkpoint). 그 사이에 전원이 나가면 다음 filesys_init 에서 header에 적힌
+ * sector들을 journal에서 제자리로 다시 써서 (replay) 마지막으로 commit 된 상태로
+ * 돌려놓음. 파일 데이터 자체는 journal에 기록하지 않음.
+ *
+ * 여러 sector를 바꾸는 file system 작업은 journal_begin/journal_end 로 감싸고,
+ * 진행 중인 작업이 없을 때만 commit 하므로 작업 하나가 반만 기록되지 않음. 작업이
+ * 끝날 때마다 commit 하지 않고 JOURNAL_BATCH 개가 모이거나 flush thread가 돌 때
+ * 한번에 commit 함.
+ *
+ * 작업은 시작할 때 JOURNAL_OP_SLOTS 개의 slot을 예약하고 그 안에서만 metadata를
+ * 바꿈. 예약할 자리가 없으면 진행 중인 작업들이 끝나서 commit 될 때까지 새 작업을
+ * 멈추므로, journal이 차서 작업 도중에 commit 하는 일이 없음. 큰 file을 늘리거나
+ * 지우는 것처럼 그보다 많이 바꾸는 작업은 각각 일관된 상태로 끝나는 단계로 나눠서
+ * 단계마다 journal_restart 로 새 작업을 시작함. */
+
+#include "filesys/journal.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4a524e4c
+
+/* Dirty metadata sectors that make an idle journal_end() commit. */
+#define JOURNAL_BATCH 16
+
+/* Journal slots reserved by each operation, which must not make more
+ * metadata sectors dirty than this. */
+#define JOURNAL_OP_SLOTS 16
+
+/* On-disk journal header.
+ * Must be exactly DISK_SECTOR_SIZE bytes long. */
+struct journal_header {
+	unsigned magic;                        /* Magic number. */
+	uint32_t cnt;                          /* Sectors in the committed transaction, 0 if none. */
+	disk_sector_t sectors[JOURNAL_SLOTS];  /* Home sector of each slot. */
+	uint8_t unused[DISK_SECTOR_SIZE - 8 - JOURNAL_SLOTS * sizeof (disk_sector_t)];
+};
+
+static bool enabled;                    /* journal_init() has run? */
+static struct lock journal_lock;        /* outstanding 을 보호하고, idle commit 동안 새 작업을 막음 */
+static struct condition journal_room_freed; /* 작업이 끝나서 예약이 풀릴 때마다 알림 */
+static int outstanding;                 /* 진행 중인 작업 수 */
+static struct journal_header header;    /* header를 쓸 때 쓰는 buffer, cache_lock 으로 보호됨 */
+
+/* Statistics. */
+static long long stat_commits;          /* Transactions committed. */
+static long long stat_logged;           /* Sectors written to the journal. */
+static long long stat_replayed;         /* Sectors replayed at mount. */
+
+/* Writes the sectors of the transaction committed in the journal, if
+ * any, to their home locations. */
+static void
+journal_replay (void) {
+	struct journal_header *h = malloc (sizeof *h);
+	uint8_t *buf = malloc (DISK_SECTOR_SIZE);
+
+	if (h == NULL || buf == NULL)
+		PANIC ("journal replay failed");
+	disk_read (filesys_disk, JOURNAL_SECTOR, h);
+	if (h->magic == JOURNAL_MAGIC && h->cnt <= JOURNAL_SLOTS) {
+		for (size_t i = 0; i < h->cnt; i++) {
+			disk_read (filesys_disk, JOURNAL_SECTOR + 1 + i, buf);
+			disk_write (filesys_disk, h->sectors[i], buf);
+		}
+		stat_replayed += h->cnt;
+	}
+	free (buf);
+	free (h);
+}
+
+/* Initializes the journal.  Unless FORMAT is true, first replays
+ * the transaction that was committed but maybe not checkpointed
+ * before the last shutdown.  Must run before any metadata is read
+ * through the buffer cache. */
+void
+journal_init (bool format) {
+	ASSERT (sizeof header == DISK_SECTOR_SIZE);
+
+	lock_init (&journal_lock);
+	cond_init (&journal_room_freed);
+	if (!format)
+		journal_replay ();
+	journal_write_header (NULL, 0);
+	enabled = true;
+}
+
+/* Returns true if metadata writes go through the journal. */
+bool
+journal_enabled (void) {
+	return enabled;
+}
+
+/* Starts a file system operation and reserves JOURNAL_OP_SLOTS
+ * journal slots for it, waiting for the running operations to end
+ * and be committed if there is no room.  No commit happens until
+ * every started operation has ended, so an operation is never split
+ * between two transactions.  An operation started within another
+ * one is part of it and uses its reservation. */
+void
+journal_begin (void) {
+	if (!enabled || thread_current ()->journal_depth++ > 0)
+		return;
+	lock_acquire (&journal_lock);
+	while (!cache_reserve (JOURNAL_OP_SLOTS)) {
+		if (outstanding == 0)
+			cache_commit (); // 진행 중인 작업이 없으니 commit 해서 자리를 만듦
+		else
+			cond_wait (&journal_room_freed, &journal_lock);
+	}
+	outstanding++;
+	lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin(), committing if it
+ * was the last one and enough metadata has been changed. */
+void
+journal_end (void) {
+	struct thread *t = thread_current ();
+
+	if (!enabled)
+		return;
+	ASSERT (t->journal_depth > 0);
+	if (--t->journal_depth > 0)
+		return;
+	lock_acquire (&journal_lock);
+	ASSERT (outstanding > 0);
+	cache_unreserve ();
+	if (--outstanding == 0 && cache_meta_count () >= JOURNAL_BATCH)
+		cache_commit (); // lock을 든 채로 commit 해야 그 사이에 새 작업이 시작되지 않음
+	cond_broadcast (&journal_room_freed, &journal_lock);
+	lock_release (&journal_lock);
+}
+
+/* Ends the running operation and starts a new one with a fresh
+ * reservation.  For operations made of steps that each leave the
+ * file system consistent, such as growing or freeing a large file,
+ * so that no step needs more than JOURNAL_OP_SLOTS slots.  Returns
+ * false, doing nothing, within a nested operation, since the outer
+ * one may be between steps of its own. */
+bool
+journal_restart (void) {
+	if (!enabled || thread_current ()->journal_depth != 1)
+		return false;
+	journal_end ();
+	journal_begin ();
+	return true;
+}
+
+/* Returns the number of journal slots the running operation has
+ * reserved but not used yet.  Without a journal, or outside an
+ * operation, nothing limits metadata writes. */
+size_t
+journal_room (void) {
+	struct thread *t = thread_current ();
+
+	if (!enabled || t->journal_depth == 0)
+		return SIZE_MAX;
+	return t->journal_left;
+}
+
+/* Commits the running transaction unless an operation is still in
+ * progress. */
+void
+journal_commit (void) {
+	if (!enabled)
+		return;
+	lock_acquire (&journal_lock);
+	if (outstanding == 0)
+		cache_commit ();
+	lock_release (&journal_lock);
+}
+
+/* Writes DATA, the contents of a logged sector, into SLOT of the
+ * journal.  Called by cache_commit(). */
+void
+journal_write_slot (size_t slot, const void *data) {
+	ASSERT (slot < JOURNAL_SLOTS);
+	disk_write (filesys_disk, JOURNAL_SECTOR + 1 + slot, data);
+}
+
+/* Writes the journal header saying that the CNT slots hold the new
+ * contents of SECTORS.  This single sector write is the commit
+ * point; CNT 0 marks the journal empty.  Called by cache_commit()
+ * with cache_lock held. */
+void
+journal_write_header (const disk_sector_t *sectors, size_t cnt) {
+	ASSERT (cnt <= JOURNAL_SLOTS);
+
+	memset (&header, 0, sizeof header);
+	header.magic = JOURNAL_MAGIC;
+	header.cnt = cnt;
+	if (cnt > 0) {
+		memcpy (header.sectors, sectors, cnt * sizeof *sectors);
+		stat_commits++;
+		stat_logged += cnt;
+	}
+	disk_write (filesys_disk, JOURNAL_SECTOR, &header);
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void) {
+	if (!enabled)
+		return;
+
+	printf ("Journal: %lld commits, %lld sectors logged, %lld replayed\n",
+			stat_commits, stat_logged, stat_replayed);
+}
@@ -0,0 +1,20 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+void cache_init (void);
+void cache_read (disk_sector_t sector, void *buffer, size_t ofs, size_t size);
+void cache_write (disk_sector_t sector, const void *buffer, size_t ofs, size_t size);
+void cache_write_meta (disk_sector_t sector, const void *buffer, size_t ofs, size_t size);
+void cache_flush (void);
+void cache_commit (void);
+size_t cache_meta_count (void);
+bool cache_reserve (size_t cnt);
+void cache_unreserve (void);
+void cache_readahead (disk_sector_t sector);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -18,6 +18,13 @@ typedef uint32_t cluster_t;  /* Index of a cluster within FAT. */
 #define FAT_BOOT_SECTOR 0     /* FAT boot sector. */
 #define ROOT_DIR_CLUSTER 1    /* Cluster for the root directory */
 
+/* Last position found in a cluster chain, see fat_seek(). */
+struct fat_pos {
+	cluster_t start;      /* First cluster of the chain. */
+	size_t idx;           /* Index of CLST within the chain. */
+	cluster_t clst;       /* Cluster found, 0 if none yet. */
+};
+
 void fat_init (void);
 void fat_open (void);
 void fat_close (void);
@@ -33,6 +40,7 @@ void fat_remove_chain (
 );
 cluster_t fat_get (cluster_t clst);
 void fat_put (cluster_t clst, cluster_t val);
+cluster_t fat_seek (cluster_t start, size_t idx, struct fat_pos *pos);
 disk_sector_t cluster_to_sector (cluster_t clst);
 
 #endif /* filesys/fat.h */
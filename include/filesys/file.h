@@ -3,6 +3,7 @@
 
 #include "filesys/off_t.h"
 #include <stdbool.h>
+#include <stddef.h>
 
 struct inode;
 
@@ -11,6 +12,9 @@ struct file {
 	struct inode *inode;        /* File's inode. */
 	off_t pos;                  /* Current position. */
 	bool deny_write;            /* Has file_deny_write() been called? */
+	off_t ra_next;              /* Offset a sequential read would start at. */
+	off_t ra_end;               /* Read ahead already requested up to here. */
+	size_t ra_window;           /* Read-ahead window in sectors, 0 if random. */
 };
 
 /* Opening and closing files. */
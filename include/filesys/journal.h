@@ -0,0 +1,24 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/disk.h"
+
+/* Journal region: a header sector followed by JOURNAL_SLOTS sectors
+ * that hold the logged metadata sectors of one transaction. */
+#define JOURNAL_SECTOR 2                /* Journal header sector. */
+#define JOURNAL_SLOTS 32                /* Sectors a transaction can log. */
+
+void journal_init (bool format);
+bool journal_enabled (void);
+void journal_begin (void);
+void journal_end (void);
+bool journal_restart (void);
+size_t journal_room (void);
+void journal_commit (void);
+void journal_write_slot (size_t slot, const void *data);
+void journal_write_header (const disk_sector_t *sectors, size_t cnt);
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
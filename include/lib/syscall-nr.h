@@ -36,6 +36,17 @@ enum {
 
 	SYS_MOUNT,
 	SYS_UMOUNT,
+
+	/* Extra. */
+	SYS_YIELD,                  /* Give up the CPU to another thread. */
+	SYS_MPROTECT,               /* Change the protection of pages. */
+	SYS_MADVISE,                /* Give a hint about the access pattern. */
+	SYS_SHM_OPEN,               /* Open or create a shared memory object. */
+	SYS_SHM_MAP,                /* Map a shared memory object. */
+	SYS_SHM_UNLINK,             /* Remove the name of a shared memory object. */
+	SYS_MEMSTAT,                /* Get memory usage of the process. */
+	SYS_SET_RSS_LIMIT,          /* Limit resident pages of the process. */
+	SYS_MSYNC,                  /* Write back modified mmapped pages. */
 };
 
 #endif /* lib/syscall-nr.h */
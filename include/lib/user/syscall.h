@@ -37,10 +37,38 @@ unsigned tell (int fd);
 void close (int fd);
 
 int dup2(int oldfd, int newfd);
+void yield (void);
 
 /* Project 3 and optionally project 4. */
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length);
+int mprotect (void *addr, size_t length, int writable);
+int madvise (void *addr, size_t length, int advice);
+
+int shm_open (const char *name, size_t size);
+void *shm_map (int id, void *addr, int writable);
+int shm_unlink (const char *name);
+
+/* Memory usage of a process, filled in by memstat(). Sizes are in pages. */
+struct memstat {
+	size_t resident;        /* Pages currently in memory. */
+	size_t resident_peak;   /* Largest value of resident so far. */
+	size_t working_set;     /* Pages accessed during the last sampling interval. */
+	size_t rss_limit;       /* Resident limit, 0 if unlimited. */
+	size_t self_evictions;  /* Own pages evicted to stay under the limit. */
+	size_t merged;          /* Pages sharing a frame through same-page merging. */
+};
+
+int memstat (struct memstat *st);
+int set_rss_limit (size_t pages);
+
+/* Access pattern hints for madvise(). */
+#define MADV_NORMAL 0           /* No special treatment. */
+#define MADV_RANDOM 1           /* Expect random access, no read-ahead. */
+#define MADV_SEQUENTIAL 2       /* Expect sequential access, read ahead more. */
+#define MADV_WILLNEED 3         /* Load the pages now. */
+#define MADV_DONTNEED 4         /* Drop the pages; anonymous ones read as zeros. */
 
 /* Project 4 only. */
 bool chdir (const char *dir);
@@ -2,24 +2,53 @@
 #define THREAD_MMU_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "threads/pte.h"
 
 typedef bool pte_for_each_func (uint64_t *pte, void *va, void *aux);
 
+/* Gathers the TLB invalidations of one range operation on a page
+ * table (e.g. munmap), so that they can be issued together by
+ * tlb_gather_finish(): one invlpg per page for small ranges, or a
+ * single flush of the whole address space once more than
+ * TLB_GATHER_MAX pages were collected.  tlb_gather_finish() is the
+ * only place that touches the TLB, so it is also where shootdown
+ * requests to other CPUs running the same page table would go. */
+#define TLB_GATHER_MAX 32
+
+struct tlb_gather {
+	uint64_t *pml4;                 /* Page table being changed. */
+	size_t cnt;                     /* Number of pages gathered. */
+	uint64_t va[TLB_GATHER_MAX];    /* The pages, while cnt fits. */
+};
+
 uint64_t *pml4e_walk (uint64_t *pml4, const uint64_t va, int create);
 uint64_t *pml4_create (void);
 bool pml4_for_each (uint64_t *, pte_for_each_func *, void *);
 void pml4_destroy (uint64_t *pml4);
 void pml4_activate (uint64_t *pml4);
+void pml4_tlb_init (void);
+void pml4_print_stats (void);
 void *pml4_get_page (uint64_t *pml4, const void *upage);
 bool pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
-void pml4_clear_page (uint64_t *pml4, void *upage);
+bool pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw);
+bool pml4_split_huge_page (uint64_t *pml4, const void *upage);
+bool pml4_clear_page (uint64_t *pml4, void *upage);
+bool pml4_clear_page_gather (struct tlb_gather *tlb, void *upage);
+bool pml4_set_writable_gather (struct tlb_gather *tlb, void *upage, bool writable);
+bool pml4_test_and_clear_accessed_gather (struct tlb_gather *tlb, const void *upage);
+void tlb_gather_init (struct tlb_gather *tlb, uint64_t *pml4);
+void tlb_gather_add (struct tlb_gather *tlb, const void *va);
+void tlb_gather_finish (struct tlb_gather *tlb);
 bool pml4_is_dirty (uint64_t *pml4, const void *upage);
 void pml4_set_dirty (uint64_t *pml4, const void *upage, bool dirty);
 bool pml4_is_accessed (uint64_t *pml4, const void *upage);
 void pml4_set_accessed (uint64_t *pml4, const void *upage, bool accessed);
 
+/* Number of 2 MiB mappings split into 4 KiB pages so far. */
+extern size_t pml4_huge_splits;
+
 #define is_writable(pte) (*(pte) & PTE_W)
 #define is_user_pte(pte) (*(pte) & PTE_U)
 #define is_kern_pte(pte) (!is_user_pte (pte))
@@ -121,6 +121,10 @@ struct thread {
   struct file *running; // rox를 위해 사용할 공간
   /* for project 2 -- end */
 
+  /* Owned by filesys/journal.c and filesys/cache.c. */
+  int journal_depth;    // 진행 중인 file system 작업 (journal_begin) 의 중첩 수
+  size_t journal_left;  // 그 작업이 예약한 journal slot 중 아직 쓰지 않은 수
+
 #ifdef USERPROG
   /* Owned by userprog/process.c. */
   uint64_t *pml4; /* Page map level 4 */
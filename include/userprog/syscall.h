@@ -7,6 +7,8 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 
+struct memstat;
+
 void syscall_init (void);
 // void check_add (void *add);
 struct page *check_add (void *add);
@@ -34,5 +36,13 @@ struct lock filesys_lock; // write 사용시에 나만 작성하기 위해서 lo
 
 void *mmap (void *addr, size_t length, int writable, int fd, off_t offset);
 void munmap (void *addr);
+int msync (void *addr, size_t length);
+int mprotect (void *addr, size_t length, int writable);
+int madvise (void *addr, size_t length, int advice);
+int shm_open (const char *name, size_t size);
+void *shm_map (int id, void *addr, int writable);
+int shm_unlink (const char *name);
+int memstat (struct memstat *st);
+int set_rss_limit (size_t pages);
 
 #endif /* userprog/syscall.h */
@@ -2,13 +2,22 @@
 #define VM_ANON_H
 #include "vm/vm.h"
 struct page;
+struct zswap_entry;
+struct ksm_node;
 enum vm_type;
 
+/* swap_index 값이 이것이면 swap disk에 내려가 있지 않은 page */
+#define SWAP_SLOT_NONE -1
+
 struct anon_page {
     int swap_index;
+    struct zswap_entry *zswap; /* 압축되어 zswap pool에 들어있으면 그 entry */
+    struct ksm_node *ksm;      /* 같은 내용의 page들과 합쳐졌으면 공유 frame */
+    uint64_t ksm_sum;          /* 지난 ksm scan 때의 내용 hash */
 };
 
 void vm_anon_init (void);
 bool anon_initializer (struct page *page, enum vm_type type, void *kva);
+bool anon_swap_write (struct page *page, const void *kva);
 
 #endif
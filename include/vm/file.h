@@ -4,14 +4,19 @@
 #include "vm/vm.h"
 
 struct page;
+struct tlb_gather;
 enum vm_type;
 
 struct file_page {
 };
 
 void vm_file_init (void);
+void file_writeback_init (void);
+void file_print_stats (void);
 bool file_backed_initializer (struct page *page, enum vm_type type, void *kva);
 void *do_mmap(void *addr, size_t length, int writable,
 		struct file *file, off_t offset);
 void do_munmap (void *va);
+void do_munmap_gather (void *va, struct tlb_gather *tlb);
+bool do_msync (void *addr, size_t length);
 #endif
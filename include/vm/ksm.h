@@ -0,0 +1,19 @@
+#ifndef VM_KSM_H
+#define VM_KSM_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct frame;
+struct ksm_node;
+
+/* ksmd 가 frame들을 훑는 주기 (초), 0이면 ksm을 사용하지 않음 */
+extern size_t ksm_scan_secs;
+
+void ksm_init (void);
+void *ksm_page_kva (struct page *page);
+void ksm_unmerge (struct page *page);
+void ksm_forget (struct frame *frame);
+void ksm_print_stats (void);
+
+#endif /* vm/ksm.h */
@@ -0,0 +1,27 @@
+#ifndef VM_SHM_H
+#define VM_SHM_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct shm_object;
+struct tlb_gather;
+enum vm_type;
+
+/* shm 객체 이름의 최대 길이 */
+#define SHM_NAME_MAX 14
+
+struct shm_page {
+	struct shm_object *obj;   /* 이 page가 매핑하고 있는 shm 객체 */
+	size_t idx;               /* 객체 안에서 몇번째 page인지 */
+};
+
+void shm_init (void);
+int shm_open_object (const char *name, size_t size);
+void *shm_map_object (int id, void *addr, bool writable);
+bool shm_unlink_object (const char *name);
+bool shm_share_page (struct page *parent);
+bool shm_claim_page (struct page *page);
+void shm_unmap_gather (void *addr, struct tlb_gather *tlb);
+
+#endif
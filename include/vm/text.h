@@ -0,0 +1,22 @@
+#ifndef VM_TEXT_H
+#define VM_TEXT_H
+#include <stdbool.h>
+
+struct page;
+struct container;
+struct text_entry;
+
+/* 같은 실행 파일을 실행하는 process들이 같이 매핑하는 read-only segment page */
+struct text_page {
+	struct text_entry *entry;  /* 내용을 가지고 있는 cache entry */
+	struct container *aux;     /* file 안에서의 위치, private page로 돌아갈 때 다시 씀 */
+};
+
+void text_init (void);
+bool text_page_eligible (struct page *page);
+bool text_claim_page (struct page *page);
+bool text_share_page (struct page *parent);
+bool text_unshare_page (struct page *page);
+void text_print_stats (void);
+
+#endif /* vm/text.h */
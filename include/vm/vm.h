@@ -13,6 +13,10 @@ enum vm_type {
 	VM_FILE = 2,
 	/* page that hold the page cache, for project 4 */
 	VM_PAGE_CACHE = 3,
+	/* page that maps a frame of a shared memory object */
+	VM_SHM = 4,
+	/* read-only page of an executable, shared through the text cache */
+	VM_TEXT = 5,
 
 	/* Bit flags to store state */
 
@@ -28,6 +32,8 @@ enum vm_type {
 #include "vm/uninit.h"
 #include "vm/anon.h"
 #include "vm/file.h"
+#include "vm/shm.h"
+#include "vm/text.h"
 #ifdef EFILESYS
 #include "filesys/page_cache.h"
 #endif
@@ -49,23 +55,53 @@ struct page {
 	/* Your implementation */
 	struct hash_elem elem_hash;
 	bool writable;
+	bool zero_mapped;      /* 공용 zero frame이 read-only로 매핑되어 있는지 */
+	uint8_t advice;        /* madvise 로 받은 접근 패턴 (enum vm_advice) */
 	/* Per-type data are binded into the union.
 	 * Each function automatically detects the current union */
 	union {
 		struct uninit_page uninit;
 		struct anon_page anon;
 		struct file_page file;
+		struct shm_page shm;
+		struct text_page text;
 #ifdef EFILESYS
 		struct page_cache page_cache;
 #endif
 	};
 };
 
+/* Access pattern hints given with madvise().  The values match the
+ * MADV_* constants of the user library. */
+enum vm_advice {
+	VM_ADV_NORMAL = 0,     /* 기본 fault-around / read-ahead */
+	VM_ADV_RANDOM = 1,     /* 미리 읽지 않음 */
+	VM_ADV_SEQUENTIAL = 2, /* 처음부터 최대로 미리 읽음 */
+	VM_ADV_WILLNEED = 3,   /* 지금 바로 올려둠 */
+	VM_ADV_DONTNEED = 4,   /* frame을 돌려줌 */
+};
+
+/* Page fault classes for latency accounting. */
+enum vm_fault_class {
+	VM_FAULT_MINOR,        /* I/O 없이 처리된 fault (0으로 채움, zero frame, shm) */
+	VM_FAULT_FILE,         /* file에서 읽어온 page */
+	VM_FAULT_SWAP,         /* swap (zswap 포함)에서 올라온 page */
+	VM_FAULT_STACK,        /* stack growth */
+	VM_FAULT_COW,          /* 공유하던 zero frame이나 ksm frame에 쓰기가 일어나 private frame을 받음 */
+	VM_FAULT_CLASS_CNT
+};
+
 /* The representation of "frame" */
 struct frame {
 	void *kva;
 	struct page *page;
 	struct list_elem elem_fr;
+	struct supplemental_page_table *owner; /* 이 frame이 resident로 계산되는 process */
+	bool zeroed;                           /* kswapd가 미리 0으로 채워둔 frame인지 */
+	bool writeback;                        /* evict 나 writeback 중이라 건드리면 안되는지, frame_lock 으로 보호함 */
+	bool ksm_unstable;                     /* ksm scan 의 unstable table에 들어있는지, frame_lock 으로 보호함 */
+	uint64_t ksm_sum;                      /* ksm scan 에서 잰 내용의 hash_bytes */
+	struct hash_elem ksm_elem;             /* ksm unstable table 의 원소 */
 };
 
 /* The function table for page operations.
@@ -89,8 +125,39 @@ struct page_operations {
  * All designs up to you for this. */
 struct supplemental_page_table {
 	struct hash pages;
+	void *ra_last_va;     /* 마지막으로 swap에서 올라온 page (순차 접근 감지용) */
+	size_t ra_window;     /* 현재 swap read-ahead window (page 수) */
+
+	/* Resident set accounting. */
+	size_t resident_cnt;  /* 지금 frame을 가지고 있는 page 수 */
+	size_t resident_peak; /* resident_cnt 의 최대값 */
+	size_t rss_limit;     /* resident page 수 제한, 0이면 제한 없음 */
+	size_t self_evict_cnt;/* 제한 때문에 자기 page를 내보낸 횟수 */
+	size_t ksm_cnt;       /* ksm 공유 frame을 매핑하고 있는 page 수 */
+	size_t ws_size;       /* 마지막 sampling 구간 동안 접근된 page 수 */
+	int64_t ws_stamp;     /* 마지막으로 working set을 sampling 한 tick */
+
+	/* Page fault accounting, per enum vm_fault_class. */
+	uint64_t fault_cnt[VM_FAULT_CLASS_CNT];    /* 처리한 fault 수 */
+	uint64_t fault_cycles[VM_FAULT_CLASS_CNT]; /* 처리하는데 걸린 cycle 합 */
 };
 
+/* Fault-around / read-ahead tuning (kernel command line -fa, -ra). */
+extern size_t vm_fault_around;
+extern size_t vm_readahead_max;
+/* 2 MiB huge page 사용 여부 (kernel command line -hp). */
+extern size_t vm_huge_pages;
+/* process 종료 시 fault 통계 출력 여부 (kernel command line -fstat). */
+extern bool vm_fault_report;
+/* kswapd 가 유지하려는 free frame 수 (kernel command line -kswapd). */
+extern size_t vm_free_high;
+/* dirty file page를 writeback 하는 주기 (초) (kernel command line -wb). */
+extern size_t vm_writeback_secs;
+
+/* 올라와있는 모든 frame 과 그걸 보호하는 lock */
+extern struct list frame_table;
+extern struct lock frame_lock;
+
 #include "threads/thread.h"
 void supplemental_page_table_init (struct supplemental_page_table *spt);
 bool supplemental_page_table_copy (struct supplemental_page_table *dst,
@@ -102,6 +169,7 @@ bool spt_insert_page (struct supplemental_page_table *spt, struct page *page);
 void spt_remove_page (struct supplemental_page_table *spt, struct page *page);
 
 void vm_init (void);
+void vm_print_stats (void);
 bool vm_try_handle_fault (struct intr_frame *f, void *addr, bool user,
 		bool write, bool not_present);
 
@@ -110,6 +178,20 @@ bool page_cmp_less(const struct hash_elem *, const struct hash_elem *, void *);
 bool insert_page(struct hash *, struct page *);
 bool delete_page(struct hash *, struct page *);
 void printf_hash(struct supplemental_page_table *spt);
+struct container *page_file_region (struct page *page);
+bool page_in_swap (struct page *page);
+void vm_unmap_zero_page (struct page *page);
+void *vm_get_pinned_page (void);
+void vm_free_pinned_page (void *kva);
+size_t vm_pinned_limit (void);
+void vm_frame_detach (struct frame *frame);
+void vm_frame_free (struct page *page);
+void vm_writeback_end (struct frame *frame);
+uint64_t *page_pml4 (struct page *page);
+void vm_ws_sample (struct supplemental_page_table *spt);
+void vm_print_fault_stats (const struct supplemental_page_table *spt, const char *name);
+bool vm_mprotect (void *addr, size_t length, bool writable);
+bool vm_madvise (void *addr, size_t length, int advice);
 
 #define vm_alloc_page(type, upage, writable) \
 	vm_alloc_page_with_initializer ((type), (upage), (writable), NULL, NULL)
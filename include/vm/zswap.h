@@ -0,0 +1,18 @@
+#ifndef VM_ZSWAP_H
+#define VM_ZSWAP_H
+#include <stdbool.h>
+#include <stddef.h>
+
+struct page;
+struct zswap_entry;
+
+/* zswap pool 크기 (page 단위), 0이면 zswap을 사용하지 않음 */
+extern size_t zswap_pool_pages;
+
+void zswap_init (void);
+bool zswap_store (struct page *page, const void *kva);
+bool zswap_load (struct page *page, void *kva);
+void zswap_invalidate (struct page *page);
+void zswap_print_stats (void);
+
+#endif /* vm/zswap.h */
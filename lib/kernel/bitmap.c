@@ -326,6 +326,22 @@ bitmap_write (const struct bitmap *b, struct file *file) {
 	off_t size = byte_cnt (b->bit_cnt);
 	return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the SIZE bytes at byte offset OFS of B's file image to
+   FILE, at the same offset, so that a change to a few bits does
+   not rewrite the whole bitmap.  The range is clipped to the end of
+   the bitmap.  Return true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+		size_t ofs, size_t size) {
+	size_t file_size = byte_cnt (b->bit_cnt);
+
+	if (ofs >= file_size)
+		return true;
+	if (size > file_size - ofs)
+		size = file_size - ofs;
+	return file_write_at (file, (const uint8_t *) b->bits + ofs, size, ofs) == (off_t) size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
@@ -155,6 +155,46 @@ munmap (void *addr) {
 	syscall1 (SYS_MUNMAP, addr);
 }
 
+int
+msync (void *addr, size_t length) {
+	return syscall2 (SYS_MSYNC, addr, length);
+}
+
+int
+mprotect (void *addr, size_t length, int writable) {
+	return syscall3 (SYS_MPROTECT, addr, length, writable);
+}
+
+int
+madvise (void *addr, size_t length, int advice) {
+	return syscall3 (SYS_MADVISE, addr, length, advice);
+}
+
+int
+shm_open (const char *name, size_t size) {
+	return syscall2 (SYS_SHM_OPEN, name, size);
+}
+
+void *
+shm_map (int id, void *addr, int writable) {
+	return (void *) syscall3 (SYS_SHM_MAP, id, addr, writable);
+}
+
+int
+shm_unlink (const char *name) {
+	return syscall1 (SYS_SHM_UNLINK, name);
+}
+
+int
+memstat (struct memstat *st) {
+	return syscall1 (SYS_MEMSTAT, st);
+}
+
+int
+set_rss_limit (size_t pages) {
+	return syscall1 (SYS_SET_RSS_LIMIT, pages);
+}
+
 bool
 chdir (const char *dir) {
 	return syscall1 (SYS_CHDIR, dir);
@@ -194,3 +234,8 @@ int
 umount (const char *path) {
 	return syscall1 (SYS_UMOUNT, path);
 }
+
+void
+yield (void) {
+	syscall0 (SYS_YIELD);
+}
@@ -0,0 +1,38 @@
+/* Creates 10,000 small files in the root directory and checks how
+   many sectors that writes to the file system disk.  Every creation
+   allocates an inode sector, so it flips a bit of the free map; only
+   the free map sector holding that bit should have to be written.
+
+   The test runs on a 32 MB disk, whose free map spans 16 sectors.
+   Rewriting the whole free map on every creation fills a journal
+   batch by itself, so each file would then cost over 30 writes to
+   the journal and back in place. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 10000
+
+/* Disk writes allowed per created file: its inode, its share of the
+   directory and free map sectors, and the journal copies of them. */
+#define WRITES_PER_FILE 4
+
+void
+test_main (void) {
+  long long write_cnt;
+  char name[16];
+  int i;
+
+  write_cnt = get_fs_disk_write_cnt ();
+  for (i = 0; i < FILE_CNT; i++) {
+    snprintf (name, sizeof name, "f%d", i);
+    if (!create (name, 0))
+      fail ("create \"%s\"", name);
+  }
+  msg ("create %d files", FILE_CNT);
+
+  CHECK (get_fs_disk_write_cnt () - write_cnt <= FILE_CNT * WRITES_PER_FILE,
+         "check write_cnt");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(bc-many-files) begin
+(bc-many-files) create 10000 files
+(bc-many-files) check write_cnt
+(bc-many-files) end
+EOF
+pass;
@@ -0,0 +1,57 @@
+/* Parent and child hand a token back and forth through a file,
+   yielding the CPU after every look at it, so that almost every
+   step is a switch between the two user address spaces.  The
+   kernel's statistics show how many of those switches kept the
+   TLB. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ROUNDS 1000
+
+/* Bumps the token whenever it is our turn, i.e. its parity is
+   PARITY, until both players had ROUNDS turns. */
+static void
+play (int fd, int parity)
+{
+  int token;
+
+  for (;;)
+    {
+      seek (fd, 0);
+      if (read (fd, &token, sizeof token) != sizeof token)
+        fail ("read token");
+      if (token >= 2 * ROUNDS)
+        break;
+      if (token % 2 == parity)
+        {
+          token++;
+          seek (fd, 0);
+          if (write (fd, &token, sizeof token) != sizeof token)
+            fail ("write token");
+        }
+      yield ();
+    }
+}
+
+void
+test_main (void)
+{
+  int fd, pid;
+
+  CHECK (create ("token", sizeof (int)), "create \"token\"");
+  CHECK ((fd = open ("token")) > 1, "open \"token\"");
+
+  pid = fork ("pong");
+  if (pid == 0)
+    {
+      play (fd, 1);
+      exit (0);
+    }
+
+  play (fd, 0);
+  if (wait (pid) != 0)
+    fail ("wait for child");
+  msg ("%d round trips", ROUNDS);
+}
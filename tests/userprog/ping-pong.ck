@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(ping-pong) begin
+(ping-pong) create "token"
+(ping-pong) open "token"
+pong: exit(0)
+(ping-pong) 1000 round trips
+(ping-pong) end
+ping-pong: exit(0)
+EOF
+pass;
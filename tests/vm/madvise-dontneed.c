@@ -0,0 +1,33 @@
+/* Writes anonymous pages, drops them with MADV_DONTNEED and checks
+   that they read back as zeros and can be written again. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define PAGE_CNT 4
+
+static char area[(PAGE_CNT + 1) * PAGE];
+
+void
+test_main (void)
+{
+  char *pages = (char *) (((uintptr_t) area + PAGE - 1) & ~(uintptr_t) (PAGE - 1));
+  size_t i;
+
+  for (i = 0; i < PAGE_CNT * PAGE; i++)
+    pages[i] = 'a' + i % 26;
+  CHECK (madvise (pages, PAGE_CNT * PAGE, MADV_DONTNEED) == 0, "madvise DONTNEED");
+
+  for (i = 0; i < PAGE_CNT * PAGE; i++)
+    if (pages[i] != 0)
+      fail ("byte %zu is %d after MADV_DONTNEED", i, pages[i]);
+  msg ("dropped pages read as zeros");
+
+  pages[PAGE] = 'x';
+  if (pages[PAGE] != 'x' || pages[PAGE + 1] != 0)
+    fail ("write after MADV_DONTNEED lost");
+  msg ("dropped pages can be written");
+}
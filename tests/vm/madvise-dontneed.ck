@@ -0,0 +1,12 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(madvise-dontneed) begin
+(madvise-dontneed) madvise DONTNEED
+(madvise-dontneed) dropped pages read as zeros
+(madvise-dontneed) dropped pages can be written
+(madvise-dontneed) end
+EOF
+pass;
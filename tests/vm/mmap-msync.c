@@ -0,0 +1,51 @@
+/* Writes to a file through a mapping and calls msync, then reads
+   the file back with the read system call while the mapping is
+   still in place.  Does it twice, so that pages written after the
+   first msync must be found dirty again. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define ACTUAL ((char *) 0x10000000)
+#define SIZE (2 * 4096)
+
+static char buf[SIZE];
+
+static void
+fill_and_sync (int handle, char base)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i++)
+    ACTUAL[i] = base + i % 13;
+  CHECK (msync (ACTUAL, SIZE) == 0, "msync");
+
+  seek (handle, 0);
+  CHECK (read (handle, buf, SIZE) == SIZE, "read \"data\"");
+  for (i = 0; i < SIZE; i++)
+    {
+      char expected = base + i % 13;
+      if (buf[i] != expected)
+        fail ("byte %zu is %d, expected %d", i, buf[i], expected);
+    }
+}
+
+void
+test_main (void)
+{
+  int map_handle, handle;
+
+  CHECK (create ("data", SIZE), "create \"data\"");
+  CHECK ((map_handle = open ("data")) > 1, "open \"data\"");
+  CHECK (mmap (ACTUAL, SIZE, 1, map_handle, 0) == ACTUAL, "mmap \"data\"");
+  CHECK ((handle = open ("data")) > 1, "open \"data\" again");
+
+  fill_and_sync (handle, 'a');
+  fill_and_sync (handle, 'A');
+
+  munmap (ACTUAL);
+  close (handle);
+  close (map_handle);
+}
@@ -0,0 +1,37 @@
+/* Makes a written page read-only with mprotect.  Reads must still
+   work, but a write must kill the process, which a child checks.
+   Making the page writable again must allow writes once more. */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+
+static char area[2 * PAGE];
+
+void
+test_main (void)
+{
+  char *page = (char *) (((uintptr_t) area + PAGE - 1) & ~(uintptr_t) (PAGE - 1));
+  pid_t pid;
+
+  page[0] = 'x';
+  CHECK (mprotect (page, PAGE, 0) == 0, "mprotect read-only");
+  if (page[0] != 'x')
+    fail ("read %d after mprotect", page[0]);
+
+  pid = fork ("child");
+  if (pid == 0) {
+    msg ("child writes read-only page");
+    page[0] = 'y';
+    fail ("write to read-only page succeeded");
+  }
+  CHECK (wait (pid) == -1, "child killed by write");
+
+  CHECK (mprotect (page, PAGE, 1) == 0, "mprotect writable");
+  page[0] = 'z';
+  if (page[0] != 'z')
+    fail ("read %d after write", page[0]);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(mprotect-ro) begin
+(mprotect-ro) mprotect read-only
+(mprotect-ro) child writes read-only page
+child: exit(-1)
+(mprotect-ro) child killed by write
+(mprotect-ro) mprotect writable
+(mprotect-ro) end
+mprotect-ro: exit(0)
+EOF
+pass;
@@ -0,0 +1,66 @@
+/* Touches one byte in every page of an 8 MB array over and over,
+   which is bound by TLB reach rather than by memory bandwidth, and
+   verifies the values.  With 2 MiB huge pages the whole array is
+   covered by a handful of TLB entries.
+
+   Checks that at least one 2 MiB aligned part of the array is backed
+   by one aligned, physically contiguous 2 MiB block, as a huge page
+   mapping must be.  The .ck file also requires the kernel to report
+   a huge page mapping at shutdown, which 4 KiB frames never do. */
+
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (8 * 1024 * 1024)
+#define PAGE 4096
+#define HUGE (2 * 1024 * 1024)
+#define PASSES 32
+
+static char buf[SIZE];
+
+/* Returns true if the 2 MiB at BASE are backed by one aligned,
+   contiguous block of physical memory. */
+static bool
+huge_backed (char *base)
+{
+  char *pa = get_phys_addr (base);
+  size_t i;
+
+  if ((uintptr_t) pa % HUGE != 0)
+    return false;
+  for (i = 0; i < HUGE; i += PAGE)
+    if ((char *) get_phys_addr (base + i) != pa + i)
+      return false;
+  return true;
+}
+
+void
+test_main (void)
+{
+  char *base;
+  size_t i;
+  int pass, huge_cnt = 0;
+
+  msg ("initialize");
+  for (i = 0; i < SIZE; i += PAGE)
+    buf[i] = (char) (i / PAGE);
+
+  base = (char *) (((uintptr_t) buf + HUGE - 1) & ~(uintptr_t) (HUGE - 1));
+  for (; base + HUGE <= buf + SIZE; base += HUGE)
+    if (huge_backed (base))
+      huge_cnt++;
+  CHECK (huge_cnt > 0, "array backed by huge pages");
+
+  msg ("strided passes");
+  for (pass = 0; pass < PASSES; pass++)
+    for (i = 0; i < SIZE; i += PAGE)
+      buf[i]++;
+
+  msg ("verify");
+  for (i = 0; i < SIZE; i += PAGE)
+    if (buf[i] != (char) (i / PAGE + PASSES))
+      fail ("byte %zu is %d", i, buf[i]);
+}
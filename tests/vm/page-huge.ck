@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+our ($test);
+my (@output) = read_text_file ("$test.output");
+fail "kernel reported no huge page mapping\n"
+  if !grep (/^Huge pages: [1-9]\d* mapped/, @output);
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-huge) begin
+(page-huge) initialize
+(page-huge) array backed by huge pages
+(page-huge) strided passes
+(page-huge) verify
+(page-huge) end
+EOF
+pass;
@@ -0,0 +1,91 @@
+/* Fills pages with contents that differ from page to page, then
+   forks, so that each page of the parent has an identical twin in
+   the child.  Same-page merging (-ksm) must merge the twins, and a
+   write to a merged page must give the writer a private copy
+   without changing what the other process sees.
+
+   The merging thread runs at the lowest priority, so the child
+   waits for it by reading a file much larger than the buffer cache,
+   which keeps it blocked on the disk most of the time, while the
+   parent is blocked in wait(). */
+
+#include <stdint.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define PAGE_CNT 8
+#define CHUNK (16 * 1024)
+
+static char area[(PAGE_CNT + 1) * PAGE];
+static char chunk[CHUNK];
+
+/* Returns the number of merged pages of this process. */
+static size_t
+merged_cnt (void)
+{
+  struct memstat st;
+
+  if (memstat (&st) != 0)
+    fail ("memstat failed");
+  return st.merged;
+}
+
+/* Reads "large.txt" until at least CNT pages of this process are
+   merged. */
+static void
+wait_merged (int handle, size_t cnt)
+{
+  while (merged_cnt () < cnt)
+    if (read (handle, chunk, CHUNK) < CHUNK)
+      seek (handle, 0);
+}
+
+/* Checks that page I of PAGES holds VALUE in every byte. */
+static void
+check_page (char *pages, size_t i, char value)
+{
+  size_t j;
+
+  for (j = 0; j < PAGE; j++)
+    if (pages[i * PAGE + j] != value)
+      fail ("byte %zu of page %zu is %d, expected %d",
+            j, i, pages[i * PAGE + j], value);
+}
+
+void
+test_main (void)
+{
+  char *pages = (char *) (((uintptr_t) area + PAGE - 1) & ~(uintptr_t) (PAGE - 1));
+  size_t i, j, merged;
+  int handle;
+  pid_t pid;
+
+  for (i = 0; i < PAGE_CNT; i++)
+    for (j = 0; j < PAGE; j++)
+      pages[i * PAGE + j] = 'a' + i;
+  CHECK ((handle = open ("large.txt")) > 1, "open \"large.txt\"");
+
+  pid = fork ("child");
+  if (pid == 0) {
+    wait_merged (handle, PAGE_CNT);
+    msg ("child pages merged");
+
+    merged = merged_cnt ();
+    pages[0] = 'z';
+    if (merged_cnt () != merged - 1)
+      fail ("write did not unmerge the page");
+    if (pages[0] != 'z' || pages[PAGE - 1] != 'a')
+      fail ("private copy of page 0 is wrong");
+    msg ("child page unmerged on write");
+    exit (0);
+  }
+
+  if (wait (pid) != 0)
+    fail ("child failed");
+  for (i = 0; i < PAGE_CNT; i++)
+    check_page (pages, i, 'a' + i);
+  msg ("parent pages unchanged");
+  close (handle);
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(page-ksm) begin
+(page-ksm) open "large.txt"
+(page-ksm) child pages merged
+(page-ksm) child page unmerged on write
+child: exit(0)
+(page-ksm) parent pages unchanged
+(page-ksm) end
+page-ksm: exit(0)
+EOF
+pass;
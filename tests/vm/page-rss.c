@@ -0,0 +1,41 @@
+/* Lowers the resident limit of the process, then writes more pages
+   than the limit allows.  The process must keep its resident set
+   under the limit by evicting its own pages, and the evicted pages
+   must come back intact. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define PAGE 4096
+#define PAGE_CNT 128
+#define LIMIT 32
+
+static char buf[PAGE_CNT * PAGE];
+
+void
+test_main (void)
+{
+  struct memstat st;
+  size_t i;
+
+  CHECK (set_rss_limit (LIMIT) == 0, "set resident limit to %d pages", LIMIT);
+
+  msg ("write %d pages", PAGE_CNT);
+  for (i = 0; i < PAGE_CNT; i++)
+    buf[i * PAGE] = (char) i;
+
+  CHECK (memstat (&st) == 0, "memstat");
+  if (st.rss_limit != LIMIT)
+    fail ("limit is %zu, expected %d", st.rss_limit, LIMIT);
+  if (st.resident > LIMIT)
+    fail ("%zu pages resident over a limit of %d", st.resident, LIMIT);
+  if (st.self_evictions == 0)
+    fail ("no page of the process was evicted");
+
+  msg ("verify");
+  for (i = 0; i < PAGE_CNT; i++)
+    if (buf[i * PAGE] != (char) i)
+      fail ("page %zu is %d", i, buf[i * PAGE]);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-rss) begin
+(page-rss) set resident limit to 32 pages
+(page-rss) write 128 pages
+(page-rss) memstat
+(page-rss) verify
+(page-rss) end
+EOF
+pass;
@@ -0,0 +1,41 @@
+/* Maps a shared memory object and forks.  The parent and the child
+   map the same frames, so each of them sees what the other one
+   writes after the fork. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SEG ((char *) 0x10000000)
+#define SIZE (2 * 4096)
+
+void
+test_main (void)
+{
+  volatile char *seg = SEG;
+  int id;
+  pid_t pid;
+
+  CHECK ((id = shm_open ("shm-fork", SIZE)) > 0, "shm_open \"shm-fork\"");
+  CHECK (shm_map (id, SEG, true) == SEG, "shm_map");
+
+  pid = fork ("child");
+  if (pid == 0) {
+    /* Wait for the parent's write after the fork. */
+    while (seg[SIZE - 1] == 0)
+      yield ();
+    if (seg[SIZE - 1] != 'p')
+      fail ("child read %d", seg[SIZE - 1]);
+    msg ("child sees parent's write");
+    seg[0] = 'c';
+    exit (0);
+  }
+
+  seg[SIZE - 1] = 'p';
+  if (wait (pid) != 0)
+    fail ("child failed");
+  if (seg[0] != 'c')
+    fail ("parent read %d", seg[0]);
+  msg ("parent sees child's write");
+  CHECK (shm_unlink ("shm-fork") == 0, "shm_unlink \"shm-fork\"");
+}
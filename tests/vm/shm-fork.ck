@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(shm-fork) begin
+(shm-fork) shm_open "shm-fork"
+(shm-fork) shm_map
+(shm-fork) child sees parent's write
+child: exit(0)
+(shm-fork) parent sees child's write
+(shm-fork) shm_unlink "shm-fork"
+(shm-fork) end
+shm-fork: exit(0)
+EOF
+pass;
@@ -21,6 +21,7 @@
 #include "threads/palloc.h"
 #include "threads/pte.h"
 #include "threads/thread.h"
+#include "intrinsic.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #include "userprog/exception.h"
@@ -31,13 +32,20 @@
 #include "tests/threads/tests.h"
 #ifdef VM
 #include "vm/vm.h"
+#include "vm/zswap.h"
+#include "vm/ksm.h"
 #endif
 #ifdef FILESYS
 #include "devices/disk.h"
+#include "filesys/cache.h"
+#include "filesys/journal.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
 
+/* CR0 bit: supervisor writes respect read-only pages. */
+#define CR0_WP 0x00010000
+
 /* Page-map-level-4 with kernel mappings only. */
 uint64_t *base_pml4;
 
@@ -155,7 +163,7 @@ paging_init (uint64_t mem_end) {
 	for (uint64_t pa = 0; pa < mem_end; pa += PGSIZE) {
 		uint64_t va = (uint64_t) ptov(pa);
 
-		perm = PTE_P | PTE_W;
+		perm = PTE_P | PTE_W | PTE_G;
 		if ((uint64_t) &start <= va && va < (uint64_t) &_end_kernel_text)
 			perm &= ~PTE_W;
 
@@ -165,6 +173,16 @@ paging_init (uint64_t mem_end) {
 
 	// reload cr3
 	pml4_activate(0);
+
+	// The kernel mappings above are the same in every address space:
+	// keep them in the TLB across process switches, and tag user
+	// mappings with PCIDs, when the CPU supports it.
+	pml4_tlb_init ();
+
+	// Make the kernel honor read-only user mappings as well, so that a
+	// kernel write into a shared (zero / copy-on-write) user page faults
+	// instead of silently modifying the shared frame.
+	lcr0 (rcr0 () | CR0_WP);
 }
 
 /* Breaks the kernel command line into words and returns them as
@@ -226,6 +244,24 @@ parse_options (char **argv) {
 			user_page_limit = atoi (value);
 		else if (!strcmp (name, "-threads-tests"))
 			thread_tests = true;
+#endif
+#ifdef VM
+		else if (!strcmp (name, "-fa"))
+			vm_fault_around = atoi (value);
+		else if (!strcmp (name, "-ra"))
+			vm_readahead_max = atoi (value);
+		else if (!strcmp (name, "-zswap"))
+			zswap_pool_pages = atoi (value);
+		else if (!strcmp (name, "-hp"))
+			vm_huge_pages = atoi (value);
+		else if (!strcmp (name, "-fstat"))
+			vm_fault_report = true;
+		else if (!strcmp (name, "-kswapd"))
+			vm_free_high = atoi (value);
+		else if (!strcmp (name, "-wb"))
+			vm_writeback_secs = atoi (value);
+		else if (!strcmp (name, "-ksm"))
+			ksm_scan_secs = atoi (value);
 #endif
 		else
 			PANIC ("unknown option `%s' (use -h for help)", name);
@@ -327,6 +363,16 @@ usage (void) {
 			"  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
 			"  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+			"  -fa=N              Fault in up to N extra file pages per fault.\n"
+			"  -ra=N              Read ahead up to N swapped pages.\n"
+			"  -zswap=N           Use N pages of RAM as compressed swap (0=off).\n"
+			"  -hp=N              Map aligned 2 MiB regions with huge pages (0=off).\n"
+			"  -fstat             Print page fault statistics when a process exits.\n"
+			"  -kswapd=N          Keep N user frames free in the background (0=off).\n"
+			"  -wb=N              Write back dirty mmapped pages every N seconds (0=off).\n"
+			"  -ksm=N             Merge identical anonymous pages every N seconds (0=off).\n"
 #endif
 			);
 	power_off ();
@@ -353,12 +399,22 @@ static void
 print_stats (void) {
 	timer_print_stats ();
 	thread_print_stats ();
+	pml4_print_stats ();
 #ifdef FILESYS
 	disk_print_stats ();
+	cache_print_stats ();
+	journal_print_stats ();
 #endif
 	console_print_stats ();
 	kbd_print_stats ();
 #ifdef USERPROG
 	exception_print_stats ();
 #endif
+#ifdef VM
+	vm_print_stats ();
+	zswap_print_stats ();
+	file_print_stats ();
+	ksm_print_stats ();
+	text_print_stats ();
+#endif
 }
@@ -1,17 +1,159 @@
+#include <debug.h>
+#include <inttypes.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/pte.h"
 #include "threads/palloc.h"
 #include "threads/thread.h"
 #include "threads/mmu.h"
 #include "intrinsic.h"
 
+/* Number of 2 MiB mappings split into 4 KiB pages so far. */
+size_t pml4_huge_splits;
+
+/* Process-context identifiers.
+ * With CR4.PCIDE set, TLB entries are tagged with the 12-bit PCID in
+ * the low bits of CR3, so switching page tables no longer has to
+ * throw away the entries of the previous process.  Each user pml4
+ * that is activated gets one of PCID_CNT - 1 IDs, handed out
+ * round-robin; PCID 0 belongs to base_pml4.  A pml4 is activated
+ * with the CR3 no-flush bit unless its ID was just (re)assigned or
+ * its page table changed while it was not active. */
+#define CR4_PGE   0x00000080        /* Global pages enable. */
+#define CR4_PCIDE 0x00020000        /* Process-context IDs enable. */
+#define CR3_NOFLUSH (1ULL << 63)    /* Keep the PCID's TLB entries. */
+#define CPUID_1_EDX_PGE   (1 << 13)
+#define CPUID_1_ECX_PCID  (1 << 17)
+#define PCID_CNT 64
+
+static bool pcid_enabled;
+static uint64_t *pcid_owner[PCID_CNT];  /* pml4 using each PCID. */
+static bool pcid_stale[PCID_CNT];       /* Changed while inactive. */
+static unsigned pcid_next = 1;          /* Next PCID to hand out. */
+
+/* Statistics. */
+static uint64_t cr3_loads;              /* Page table switches. */
+static uint64_t cr3_noflush_loads;      /* ...that kept the TLB. */
+
+/* Turns on global pages and PCIDs if the CPU supports them.  Called
+ * once the kernel page table, whose mappings carry PTE_G, is
+ * active. */
+void
+pml4_tlb_init (void) {
+	uint32_t eax, ebx, ecx, edx;
+
+	cpuid (1, &eax, &ebx, &ecx, &edx);
+	if (edx & CPUID_1_EDX_PGE)
+		lcr4 (rcr4 () | CR4_PGE);
+	if ((ecx & CPUID_1_ECX_PCID) && (rcr3 () & PTE_FLAGS) == 0) {
+		lcr4 (rcr4 () | CR4_PCIDE);
+		pcid_enabled = true;
+	}
+}
+
+/* Returns true if PML4 is the page table the CPU is using. */
+static bool
+pml4_is_active (uint64_t *pml4) {
+	return PTE_ADDR (rcr3 ()) == vtop (pml4);
+}
+
+/* Returns the PCID slot of PML4, or 0 if it has none. */
+static unsigned
+pcid_lookup (uint64_t *pml4) {
+	for (unsigned i = 1; i < PCID_CNT; i++)
+		if (pcid_owner[i] == pml4)
+			return i;
+	return 0;
+}
+
+/* Returns the CR3 value that activates PML4, assigning a PCID if
+ * needed.  Interrupts must be off. */
+static uint64_t
+pcid_cr3 (uint64_t *pml4) {
+	unsigned id;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (pml4 == base_pml4)
+		return vtop (pml4) | CR3_NOFLUSH;   /* No user mappings. */
+
+	id = pcid_lookup (pml4);
+	if (id != 0 && !pcid_stale[id])
+		return vtop (pml4) | id | CR3_NOFLUSH;
+	if (id == 0) {
+		id = pcid_next;
+		pcid_next = pcid_next % (PCID_CNT - 1) + 1;
+		pcid_owner[id] = pml4;
+	}
+	pcid_stale[id] = false;
+	return vtop (pml4) | id;                /* Flushes this PCID. */
+}
+
+/* Drops any TLB entry for VA in PML4.  If PML4 is not active, its
+ * cached entries are dropped when it is activated next. */
+static void
+tlb_invalidate (uint64_t *pml4, uint64_t va) {
+	if (pml4_is_active (pml4))
+		invlpg (va);
+	else if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned id = pcid_lookup (pml4);
+		if (id != 0)
+			pcid_stale[id] = true;
+		intr_set_level (old_level);
+	}
+}
+
+/* Drops all non-global TLB entries of PML4. */
+static void
+tlb_flush (uint64_t *pml4) {
+	if (pml4_is_active (pml4))
+		lcr3 (rcr3 ());
+	else
+		tlb_invalidate (pml4, 0);
+}
+
+/* Prints PCID statistics. */
+void
+pml4_print_stats (void) {
+	if (pcid_enabled)
+		printf ("PCID: %"PRIu64" address space switches, %"PRIu64" kept the TLB\n",
+				cr3_loads, cr3_noflush_loads);
+}
+
+/* Replaces the 2 MiB mapping in PDE by a page table of 512 4 KiB
+ * PTEs that map the same frames with the same permissions.
+ * Returns false if no page table could be allocated. */
+static bool
+pgdir_split (uint64_t *pde) {
+	uint64_t *pt = palloc_get_page (0);
+	if (pt == NULL)
+		return false;
+
+	uint64_t base = PTE_ADDR (*pde) & ~(HPGSIZE - 1);
+	uint64_t flags = *pde & PTE_FLAGS & ~PTE_PS;
+	for (unsigned i = 0; i < HPGCNT; i++)
+		pt[i] = (base + i * PGSIZE) | flags;
+	*pde = vtop (pt) | PTE_U | PTE_W | PTE_P;
+	pml4_huge_splits++;
+	return true;
+}
+
+/* For a 2 MiB mapping, returns the PDE itself when CREATE is false,
+ * and splits it into 4 KiB PTEs first when CREATE is true. */
 static uint64_t *
 pgdir_walk (uint64_t *pdp, const uint64_t va, int create) {
 	int idx = PDX (va);
 	if (pdp) {
+		if (pdp[idx] & PTE_PS) {
+			if (!create)
+				return &pdp[idx];
+			if (!pgdir_split (&pdp[idx]))
+				return NULL;
+		}
 		uint64_t *pte = (uint64_t *) pdp[idx];
 		if (!((uint64_t) pte & PTE_P)) {
 			if (create) {
@@ -60,7 +202,10 @@ pdpe_walk (uint64_t *pdpe, const uint64_t va, int create) {
  * If PML4E does not have a page table for VADDR, behavior depends
  * on CREATE.  If CREATE is true, then a new page table is
  * created and a pointer into it is returned.  Otherwise, a null
- * pointer is returned. */
+ * pointer is returned.
+ * If VADDR lies in a 2 MiB mapping, the page-directory entry (with
+ * PTE_PS set) is returned when CREATE is false; when CREATE is true
+ * the mapping is split first. */
 uint64_t *
 pml4e_walk (uint64_t *pml4e, const uint64_t va, int create) {
 	uint64_t *pte = NULL;
@@ -122,7 +267,14 @@ pgdir_for_each (uint64_t *pdp, pte_for_each_func *func, void *aux,
 		unsigned pml4_index, unsigned pdp_index) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && (pdp[i] & PTE_PS)) {
+			/* A 2 MiB mapping is passed as its page-directory entry. */
+			void *va = (void *) (((uint64_t) pml4_index << PML4SHIFT) |
+								 ((uint64_t) pdp_index << PDPESHIFT) |
+								 ((uint64_t) i << PDXSHIFT));
+			if (!func (&pdp[i], va, aux))
+				return false;
+		} else if (((uint64_t) pte) & PTE_P)
 			if (!pt_for_each ((uint64_t *) PTE_ADDR (pte), func, aux,
 					pml4_index, pdp_index, i))
 				return false;
@@ -169,7 +321,9 @@ static void
 pgdir_destroy (uint64_t *pdp) {
 	for (unsigned i = 0; i < PGSIZE / sizeof(uint64_t *); i++) {
 		uint64_t *pte = ptov((uint64_t *) pdp[i]);
-		if (((uint64_t) pte) & PTE_P)
+		if ((((uint64_t) pte) & PTE_P) && (pdp[i] & PTE_PS))
+			palloc_free_multiple ((void *) PTE_ADDR (pte), HPGCNT);
+		else if (((uint64_t) pte) & PTE_P)
 			pt_destroy (PTE_ADDR (pte));
 	}
 	palloc_free_page ((void *) pdp);
@@ -196,14 +350,38 @@ pml4_destroy (uint64_t *pml4) {
 	uint64_t *pdpe = ptov ((uint64_t *) pml4[0]);
 	if (((uint64_t) pdpe) & PTE_P)
 		pdpe_destroy ((void *) PTE_ADDR (pdpe));
+
+	/* Release the PCID, so that a new pml4 allocated at the same
+	 * address cannot pick up this one's TLB entries. */
+	if (pcid_enabled) {
+		enum intr_level old_level = intr_disable ();
+		unsigned id = pcid_lookup (pml4);
+		if (id != 0)
+			pcid_owner[id] = NULL;
+		intr_set_level (old_level);
+	}
 	palloc_free_page ((void *) pml4);
 }
 
 /* Loads page directory PD into the CPU's page directory base
- * register. */
+ * register.  With PCIDs, the TLB entries of PD survive from its last
+ * activation when possible. */
 void
 pml4_activate (uint64_t *pml4) {
-	lcr3 (vtop (pml4 ? pml4 : base_pml4));
+	if (pml4 == NULL)
+		pml4 = base_pml4;
+	if (!pcid_enabled) {
+		lcr3 (vtop (pml4));
+		return;
+	}
+
+	enum intr_level old_level = intr_disable ();
+	uint64_t cr3 = pcid_cr3 (pml4);
+	cr3_loads++;
+	if (cr3 & CR3_NOFLUSH)
+		cr3_noflush_loads++;
+	lcr3 (cr3);
+	intr_set_level (old_level);
 }
 
 /* Looks up the physical address that corresponds to user virtual
@@ -216,6 +394,9 @@ pml4_get_page (uint64_t *pml4, const void *uaddr) {
 
 	uint64_t *pte = pml4e_walk (pml4, (uint64_t) uaddr, 0);
 
+	if (pte && (*pte & PTE_P) && (*pte & PTE_PS))
+		return ptov (PTE_ADDR (*pte) & ~(HPGSIZE - 1))
+			+ ((uint64_t) uaddr & (HPGSIZE - 1));
 	if (pte && (*pte & PTE_P))
 		return ptov (PTE_ADDR (*pte)) + pg_ofs (uaddr);
 	return NULL;
@@ -243,23 +424,187 @@ pml4_set_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
 	return pte != NULL;
 }
 
+/* Returns the page-directory entry for VA in PML4, allocating the
+ * upper two levels if CREATE is true.  Returns a null pointer if
+ * they are missing and CREATE is false or allocation fails. */
+static uint64_t *
+pde_lookup (uint64_t *pml4, const uint64_t va, int create) {
+	uint64_t *table = pml4;
+	int idx[2] = { PML4 (va), PDPE (va) };
+
+	for (int i = 0; i < 2; i++) {
+		uint64_t *e = &table[idx[i]];
+		if (!(*e & PTE_P)) {
+			if (!create)
+				return NULL;
+			uint64_t *new_page = palloc_get_page (PAL_ZERO);
+			if (new_page == NULL)
+				return NULL;
+			*e = vtop (new_page) | PTE_U | PTE_W | PTE_P;
+		}
+		table = ptov (PTE_ADDR (*e));
+	}
+	return &table[PDX (va)];
+}
+
+/* Maps the 2 MiB user region starting at UPAGE to the physically
+ * contiguous frames starting at KPAGE with a single page-directory
+ * entry.  Both must be 2 MiB aligned.  Fails if any page of the
+ * region is already mapped, or on allocation failure.  An empty page
+ * table left in the way is freed. */
+bool
+pml4_set_huge_page (uint64_t *pml4, void *upage, void *kpage, bool rw) {
+	ASSERT ((uint64_t) upage % HPGSIZE == 0);
+	ASSERT (vtop (kpage) % HPGSIZE == 0);
+	ASSERT (is_user_vaddr (upage));
+	ASSERT (pml4 != base_pml4);
+
+	uint64_t *pde = pde_lookup (pml4, (uint64_t) upage, true);
+	if (pde == NULL)
+		return false;
+
+	if (*pde & PTE_P) {
+		if (*pde & PTE_PS)
+			return false;
+		uint64_t *pt = ptov (PTE_ADDR (*pde));
+		for (unsigned i = 0; i < HPGCNT; i++)
+			if (pt[i] & PTE_P)
+				return false;
+		*pde = 0;
+		palloc_free_page (pt);
+		tlb_invalidate (pml4, (uint64_t) upage); /* Drops cached walks through the old table. */
+	}
+	*pde = vtop (kpage) | PTE_PS | PTE_P | (rw ? PTE_W : 0) | PTE_U;
+	return true;
+}
+
+/* If UPAGE lies in a 2 MiB mapping of PML4, replaces that mapping by
+ * 4 KiB PTEs so that single pages of it can be changed.  Returns
+ * false only if the page table for the split could not be
+ * allocated. */
+bool
+pml4_split_huge_page (uint64_t *pml4, const void *upage) {
+	uint64_t *pde = pml4e_walk (pml4, (uint64_t) upage, false);
+
+	if (pde == NULL || !(*pde & PTE_PS))
+		return true;
+	if (!pgdir_split (pde))
+		return false;
+	tlb_flush (pml4);   /* Drop the stale 2 MiB TLB entry. */
+	return true;
+}
+
 /* Marks user virtual page UPAGE "not present" in page
  * directory PD.  Later accesses to the page will fault.  Other
- * bits in the page table entry are preserved.
- * UPAGE need not be mapped. */
-void
+ * bits in the page table entry are preserved.  A 2 MiB mapping
+ * containing UPAGE is split first.
+ * UPAGE need not be mapped.  Returns false, changing nothing, if
+ * the page table for the split could not be allocated. */
+bool
 pml4_clear_page (uint64_t *pml4, void *upage) {
+	struct tlb_gather tlb;
+	bool success;
+
+	tlb_gather_init (&tlb, pml4);
+	success = pml4_clear_page_gather (&tlb, upage);
+	tlb_gather_finish (&tlb);
+	return success;
+}
+
+/* Like pml4_clear_page() on TLB->pml4, but leaves the TLB
+ * invalidation to tlb_gather_finish(). */
+bool
+pml4_clear_page_gather (struct tlb_gather *tlb, void *upage) {
+	uint64_t *pml4 = tlb->pml4;
 	uint64_t *pte;
 	ASSERT (pg_ofs (upage) == 0);
 	ASSERT (is_user_vaddr (upage));
 
+	if (!pml4_split_huge_page (pml4, upage))
+		return false;
 	pte = pml4e_walk (pml4, (uint64_t) upage, false);
 
 	if (pte != NULL && (*pte & PTE_P) != 0) {
 		*pte &= ~PTE_P;
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) upage);
+		tlb_gather_add (tlb, upage);
+	}
+	return true;
+}
+
+/* Makes the mapping of user page UPAGE in TLB->pml4 read/write if
+ * WRITABLE, read-only otherwise, splitting a 2 MiB mapping around it
+ * first.  The TLB invalidation is left to tlb_gather_finish().
+ * UPAGE need not be mapped.  Returns false, changing nothing, if the
+ * page table for the split could not be allocated. */
+bool
+pml4_set_writable_gather (struct tlb_gather *tlb, void *upage, bool writable) {
+	uint64_t *pml4 = tlb->pml4;
+	uint64_t *pte;
+	ASSERT (pg_ofs (upage) == 0);
+	ASSERT (is_user_vaddr (upage));
+
+	if (!pml4_split_huge_page (pml4, upage))
+		return false;
+	pte = pml4e_walk (pml4, (uint64_t) upage, false);
+	if (pte == NULL || (*pte & PTE_P) == 0)
+		return true;
+
+	if (writable != ((*pte & PTE_W) != 0)) {
+		if (writable)
+			*pte |= PTE_W;
+		else
+			*pte &= ~(uint64_t) PTE_W;
+		tlb_gather_add (tlb, upage);
 	}
+	return true;
+}
+
+/* Clears the accessed bit of the PTE for UPAGE in TLB's page table
+ * and returns its previous value.  The TLB invalidation is left to
+ * tlb_gather_finish(). */
+bool
+pml4_test_and_clear_accessed_gather (struct tlb_gather *tlb, const void *upage) {
+	uint64_t *pte = pml4e_walk (tlb->pml4, (uint64_t) upage, false);
+
+	if (pte == NULL || (*pte & PTE_A) == 0)
+		return false;
+	*pte &= ~(uint64_t) PTE_A;
+	tlb_gather_add (tlb, upage);
+	return true;
+}
+
+/* Starts gathering TLB invalidations for PML4. */
+void
+tlb_gather_init (struct tlb_gather *tlb, uint64_t *pml4) {
+	tlb->pml4 = pml4;
+	tlb->cnt = 0;
+}
+
+/* Records that the translation of VA in TLB->pml4 changed. */
+void
+tlb_gather_add (struct tlb_gather *tlb, const void *va) {
+	if (tlb->cnt < TLB_GATHER_MAX)
+		tlb->va[tlb->cnt] = (uint64_t) va;
+	tlb->cnt++;
+}
+
+/* Issues the gathered invalidations: invlpg for each page if there
+ * are at most TLB_GATHER_MAX of them, since refilling the whole TLB
+ * costs more than that many invlpg; otherwise one full flush.  If
+ * TLB->pml4 is not active, its PCID (if any) is marked stale
+ * instead. */
+void
+tlb_gather_finish (struct tlb_gather *tlb) {
+	if (tlb->cnt == 0)
+		return;
+	if (!pml4_is_active (tlb->pml4))
+		tlb_invalidate (tlb->pml4, 0);
+	else if (tlb->cnt > TLB_GATHER_MAX)
+		tlb_flush (tlb->pml4);
+	else
+		for (size_t i = 0; i < tlb->cnt; i++)
+			invlpg (tlb->va[i]);
+	tlb->cnt = 0;
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PML4 is dirty,
@@ -283,8 +628,10 @@ pml4_set_dirty (uint64_t *pml4, const void *vpage, bool dirty) {
 		else
 			*pte &= ~(uint32_t) PTE_D;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		/* A not-present PTE has no TLB entry of its own; one still
+		 * pending in a tlb_gather is dropped by tlb_gather_finish(). */
+		if (*pte & PTE_P)
+			tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
 
@@ -309,7 +656,6 @@ pml4_set_accessed (uint64_t *pml4, const void *vpage, bool accessed) {
 		else
 			*pte &= ~(uint32_t) PTE_A;
 
-		if (rcr3 () == vtop (pml4))
-			invlpg ((uint64_t) vpage);
+		tlb_invalidate (pml4, (uint64_t) vpage);
 	}
 }
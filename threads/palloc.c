@@ -8,6 +8,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/init.h"
+#include "threads/interrupt.h"
 #include "threads/loader.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
@@ -31,6 +32,7 @@ struct pool {
 	struct lock lock;               /* Mutual exclusion. */
 	struct bitmap *used_map;        /* Bitmap of free pages. */
 	uint8_t *base;                  /* Base of pool. */
+	size_t free_cnt;                /* Number of free pages. */
 };
 
 /* Two pools: one for kernel data, one for user pages. */
@@ -42,6 +44,7 @@ static void
 init_pool (struct pool *p, void **bm_base, uint64_t start, uint64_t end);
 
 static bool page_from_pool (const struct pool *, void *page);
+static void pool_adjust_free (struct pool *, int64_t delta);
 
 /* multiboot info */
 struct multiboot_info {
@@ -224,11 +227,13 @@ split:
 			if ((uint64_t) pool_end < end) {
 				page_cnt = ((uint64_t) pool_end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool->free_cnt += page_cnt;
 				start = (uint64_t) pool_end;
 				goto split;
 			} else {
 				page_cnt = ((uint64_t) end - start) / PGSIZE;
 				bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+				pool->free_cnt += page_cnt;
 			}
 		}
 	}
@@ -265,6 +270,47 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt) {
 
 	lock_acquire (&pool->lock);
 	size_t page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+	if (page_idx != BITMAP_ERROR)
+		pool_adjust_free (pool, -(int64_t) page_cnt);
+	lock_release (&pool->lock);
+	void *pages;
+
+	if (page_idx != BITMAP_ERROR)
+		pages = pool->base + PGSIZE * page_idx;
+	else
+		pages = NULL;
+
+	if (pages) {
+		if (flags & PAL_ZERO)
+			memset (pages, 0, PGSIZE * page_cnt);
+	} else {
+		if (flags & PAL_ASSERT)
+			PANIC ("palloc_get: out of pages");
+	}
+
+	return pages;
+}
+
+/* Like palloc_get_multiple(), but the first page's address is a
+   multiple of ALIGN_CNT pages, e.g. for a 2 MiB huge page frame.
+   Kernel virtual addresses keep the alignment of the physical
+   ones, so the frame is physically aligned as well. */
+void *
+palloc_get_aligned (enum palloc_flags flags, size_t page_cnt, size_t align_cnt) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	size_t page_idx = BITMAP_ERROR;
+	size_t i;
+
+	ASSERT (align_cnt > 0);
+	lock_acquire (&pool->lock);
+	for (i = (align_cnt - pg_no (pool->base) % align_cnt) % align_cnt;
+			i + page_cnt <= bitmap_size (pool->used_map); i += align_cnt)
+		if (bitmap_none (pool->used_map, i, page_cnt)) {
+			bitmap_set_multiple (pool->used_map, i, page_cnt, true);
+			pool_adjust_free (pool, -(int64_t) page_cnt);
+			page_idx = i;
+			break;
+		}
 	lock_release (&pool->lock);
 	void *pages;
 
@@ -320,6 +366,15 @@ palloc_free_multiple (void *pages, size_t page_cnt) {
 #endif
 	ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
 	bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+	pool_adjust_free (pool, page_cnt);
+}
+
+/* Returns the number of free pages in the user pool if PAL_USER is
+   set in FLAGS, otherwise in the kernel pool. */
+size_t
+palloc_free_cnt (enum palloc_flags flags) {
+	struct pool *pool = flags & PAL_USER ? &user_pool : &kernel_pool;
+	return pool->free_cnt;
 }
 
 /* Frees the page at PAGE. */
@@ -356,3 +411,13 @@ page_from_pool (const struct pool *pool, void *page) {
 	size_t end_page = start_page + bitmap_size (pool->used_map);
 	return page_no >= start_page && page_no < end_page;
 }
+
+/* Adds DELTA to the free page count of POOL.  Pages are freed
+   without holding the pool lock, possibly from the scheduler, so
+   the count is updated with interrupts off instead. */
+static void
+pool_adjust_free (struct pool *pool, int64_t delta) {
+	enum intr_level old_level = intr_disable ();
+	pool->free_cnt += delta;
+	intr_set_level (old_level);
+}
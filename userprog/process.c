@@ -212,6 +212,7 @@ __do_fork (void *aux) {
   supplemental_page_table_init (&current->spt);
   if (!supplemental_page_table_copy (&current->spt, &parent->spt))
     goto error;
+  current->stack_bottom = parent->stack_bottom; // stack page들은 그대로 복사되었으니 stack 끝도 같음
 #else
   if (!pml4_for_each (parent->pml4, duplicate_pte, fork_argv)) // pte_entry table에 duplicate_pte 함수를 적용함 --> 실패하면 error로 가고 아니면 진행
     goto error;
@@ -329,6 +330,11 @@ process_exit (void) {
    * TODO: project2/process_termination.html).
    * TODO: We recommend you to implement process resource cleanup here. */
 
+#ifdef VM
+  if (vm_fault_report)
+    vm_print_fault_stats (&curr->spt, curr->name); // "-fstat" 일 때만 출력해야 test 결과가 달라지지 않음
+#endif
+
   for (int i = 2; i < FD_COUNT_LIMT; i++) // process가 끝나는 신호가 들어오면 해당 process에서 열려있던 file들을 모두 닫아줌
     close_handler (i); 
 
@@ -790,8 +796,7 @@ lazy_load_segment (struct page *page, void *aux) { // 실행 파일로부터 seg
   file_seek(file, aux_offset); // file_seek를 통해서 file의 읽기를 시작할 부분으로 offset 만큼 이동 시켜줌
 
   if(file_read(file, page->frame->kva, aux_read_byte) != (int)aux_read_byte){ // kva에서 file을 aux_read_byte 만큼 읽은 크기가 input된 aux_read_byte의 크기랑 동일하지 않다면 --> 읽은게 이상하다
-    palloc_free_page(page->frame->kva); // 해당 page free 해버림
-    return false;
+    return false; // frame은 호출한 쪽이 가지고 있으니 여기서 free 하지 않음
   }
   memset(page->frame->kva + aux_read_byte, 0, page_zero_byte); // 잘 읽어왔다면 버퍼에 read_byte를 더한 공간을 page_zero_byte 만큼 0으로 채워넣어줌
 
@@ -120,6 +120,33 @@ syscall_handler (struct intr_frame *f UNUSED) {
     case SYS_MUNMAP:
       munmap(a1);
       break;
+    case SYS_YIELD:
+      thread_yield ();   // 다른 thread에게 CPU를 양보함 (process 전환 측정용)
+      break;
+    case SYS_MPROTECT:
+      f->R.rax = mprotect ((void *) a1, a2, a3);
+      break;
+    case SYS_MADVISE:
+      f->R.rax = madvise ((void *) a1, a2, a3);
+      break;
+    case SYS_SHM_OPEN:
+      f->R.rax = shm_open ((const char *) a1, a2);
+      break;
+    case SYS_SHM_MAP:
+      f->R.rax = (uint64_t) shm_map (a1, (void *) a2, a3);
+      break;
+    case SYS_SHM_UNLINK:
+      f->R.rax = shm_unlink ((const char *) a1);
+      break;
+    case SYS_MEMSTAT:
+      f->R.rax = memstat ((struct memstat *) a1);
+      break;
+    case SYS_SET_RSS_LIMIT:
+      f->R.rax = set_rss_limit (a1);
+      break;
+    case SYS_MSYNC:
+      f->R.rax = msync ((void *) a1, a2);
+      break;
 
     default:
       exit_handler (-1);
@@ -411,4 +438,77 @@ void
 void 
 munmap (void *addr){
   do_munmap(addr);
-}
\ No newline at end of file
+}
+
+/* Checks the range of mprotect() and madvise(): ADDR must be a page
+ * aligned user address and [ADDR, ADDR + LENGTH) must not wrap
+ * around or reach into kernel space. */
+static bool
+check_page_range (void *addr, size_t length) {
+  if (pg_round_down (addr) != addr || addr == NULL || length == 0) // page 단위로 맞춰져 있고 길이가 있어야 함
+    return false;
+  if (addr + length < addr || !is_user_vaddr (addr + length - 1)) // 끝 주소가 넘쳐서 돌아가거나 kernel 영역이면 안됨
+    return false;
+  return true;
+}
+
+int
+msync (void *addr, size_t length) {
+  if (!check_page_range (addr, length))
+    return -1;
+  return do_msync (addr, length) ? 0 : -1;
+}
+
+int
+mprotect (void *addr, size_t length, int writable) {
+  if (!check_page_range (addr, length))
+    return -1;
+  return vm_mprotect (addr, length, writable != 0) ? 0 : -1;
+}
+
+int
+madvise (void *addr, size_t length, int advice) {
+  if (!check_page_range (addr, length))
+    return -1;
+  return vm_madvise (addr, length, advice) ? 0 : -1;
+}
+
+int
+shm_open (const char *name, size_t size) {
+  check_add ((void *) name);
+  return shm_open_object (name, size);
+}
+
+void *
+shm_map (int id, void *addr, int writable) {
+  if (pg_round_down (addr) != addr || addr == NULL || is_kernel_vaddr (addr)) // mmap과 같이 page 단위의 user 주소여야 함
+    return NULL;
+  return shm_map_object (id, addr, writable != 0);
+}
+
+int
+shm_unlink (const char *name) {
+  check_add ((void *) name);
+  return shm_unlink_object (name) ? 0 : -1;
+}
+
+int
+memstat (struct memstat *st) {
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+
+  check_buff (st, sizeof *st, NULL, true); // 결과를 써줄 곳이니 쓰기가 가능해야 함
+  vm_ws_sample (spt); // 지금까지의 구간으로 working set을 다시 잼
+  st->resident = spt->resident_cnt;
+  st->resident_peak = spt->resident_peak;
+  st->working_set = spt->ws_size;
+  st->rss_limit = spt->rss_limit;
+  st->self_evictions = spt->self_evict_cnt;
+  st->merged = spt->ksm_cnt;
+  return 0;
+}
+
+int
+set_rss_limit (size_t pages) {
+  thread_current ()->spt.rss_limit = pages; // 0이면 제한을 풀어줌
+  return 0;
+}
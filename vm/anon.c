@@ -1,7 +1,13 @@
 /* anon.c: Implementation of page for non-disk image (a.k.a. anonymous page). */
 
+#include <round.h>
+#include <string.h>
 #include "vm/vm.h"
+#include "vm/zswap.h"
+#include "vm/ksm.h"
 #include "threads/vaddr.h"
+#include "threads/synch.h"
+#include "threads/malloc.h"
 #include "devices/disk.h"
 #include "kernel/bitmap.h"
 #include "threads/mmu.h"
@@ -14,7 +20,25 @@ static void anon_destroy (struct page *page);
 
 /* project for 3 - start */
 struct bitmap *swap_table;
-const size_t SECTORS_PER_PAGE = PGSIZE / DISK_SECTOR_SIZE; // 256KB/512B -> 512
+const size_t SECTORS_PER_PAGE = PGSIZE / DISK_SECTOR_SIZE; // 4KB/512B -> 8
+
+/* Swap slot allocator.
+ * slot 들을 SWAP_CLUSTER_SLOTS 개씩 cluster로 묶어서 cluster 별 free slot 개수를
+ * 관리함. 마지막으로 할당한 slot의 다음 위치(swap_cursor)를 먼저 시도하기 때문에
+ * 같이 evict 되는 page들은 연속된 slot에 들어가게 되고 (swap-in read-ahead에 유리),
+ * cursor가 막혔을 때는 cluster 단위로만 건너뛰면서 찾으므로 slot 0부터 bitmap
+ * 전체를 훑을 필요가 없음. */
+#define SWAP_CLUSTER_SLOTS 16
+
+static struct lock swap_lock;      /* swap_table과 아래 정보들을 보호함 */
+static size_t swap_slot_cnt;       /* 전체 slot 개수 */
+static size_t swap_free_cnt;       /* 남아있는 free slot 개수 */
+static size_t swap_cursor;         /* 다음에 할당을 시도할 slot */
+static size_t swap_cluster_cnt;    /* cluster 개수 */
+static uint8_t *swap_cluster_free; /* cluster 별 free slot 개수 */
+
+static size_t swap_slot_alloc (void);
+static void swap_slot_free (size_t slot);
 /* project for 3 - end */
 
 /* DO NOT MODIFY this struct */
@@ -32,8 +56,24 @@ vm_anon_init (void) {
 	/* TODO: Set up the swap_disk. */
 	swap_disk = disk_get(1,1); // swap disk를 받아줌
 
-	size_t swap_size = disk_size(swap_disk) / SECTORS_PER_PAGE; // 할당된 swap_disk의 사이즈를 512로 나눔
-	swap_table = bitmap_create(swap_size); // swap_size에 맞는 bitmap을 만들어서 swap_table로 반환함
+	lock_init (&swap_lock);
+	swap_slot_cnt = swap_disk != NULL ? disk_size(swap_disk) / SECTORS_PER_PAGE : 0; // 할당된 swap_disk의 사이즈를 page 당 sector 수로 나눔
+	swap_table = bitmap_create(swap_slot_cnt); // swap_size에 맞는 bitmap을 만들어서 swap_table로 반환함
+	if (swap_table == NULL)
+		PANIC ("swap table creation failed");
+	swap_free_cnt = swap_slot_cnt;
+	swap_cursor = 0;
+
+	swap_cluster_cnt = DIV_ROUND_UP (swap_slot_cnt, SWAP_CLUSTER_SLOTS);
+	swap_cluster_free = malloc (swap_cluster_cnt > 0 ? swap_cluster_cnt : 1);
+	if (swap_cluster_free == NULL)
+		PANIC ("swap cluster table creation failed");
+	for (size_t i = 0; i < swap_cluster_cnt; i++) { // 마지막 cluster는 slot이 모자랄 수 있음
+		size_t left = swap_slot_cnt - i * SWAP_CLUSTER_SLOTS;
+		swap_cluster_free[i] = left < SWAP_CLUSTER_SLOTS ? left : SWAP_CLUSTER_SLOTS;
+	}
+
+	zswap_init (); // swap disk 앞에 둘 압축 cache
 }
 
 /* Initialize the file mapping */
@@ -42,7 +82,70 @@ anon_initializer (struct page *page, enum vm_type type, void *kva) {
 	/* Set up the handler */
 	page->operations = &anon_ops; // page->operation 에 anonymous type을 넣어줌
 
+	bool zero_fill = page->uninit.init == NULL; // 채워줄 내용이 없는 page (stack 등) -- swap_index가 덮어쓰기 전에 확인
+
 	struct anon_page *anon_page = &page->anon; // page->anon 의 주소를 anon_page로 연결
+	anon_page->swap_index = SWAP_SLOT_NONE; // 아직 swap disk에 내려간 적이 없음
+	anon_page->zswap = NULL;
+	anon_page->ksm = NULL;
+	anon_page->ksm_sum = 0;
+	if (zero_fill && !(page->frame != NULL && page->frame->zeroed)) // kswapd가 미리 0으로 채워둔 frame이면 할 필요 없음
+		memset (kva, 0, PGSIZE); // anonymous memory는 항상 0으로 시작해야 zero page를 읽던 내용과 같음
+	return true;
+}
+
+/* Returns a free swap slot and marks it used, or BITMAP_ERROR if the
+ * swap disk is full.  Tries the slot right after the previous
+ * allocation first, then the first completely free cluster, then any
+ * cluster that still has room. */
+static size_t
+swap_slot_alloc (void) {
+	size_t slot = BITMAP_ERROR;
+
+	lock_acquire (&swap_lock);
+	if (swap_free_cnt == 0)
+		goto done;
+
+	if (swap_cursor < swap_slot_cnt && !bitmap_test (swap_table, swap_cursor)) {
+		slot = swap_cursor; // 바로 직전에 할당한 slot의 다음칸이 비어있으면 그대로 사용
+	} else {
+		size_t start = swap_cursor / SWAP_CLUSTER_SLOTS;
+		size_t c, i;
+
+		// 새로운 연속 구간을 시작할 수 있도록 완전히 비어있는 cluster를 먼저 찾고
+		for (i = 0; i < swap_cluster_cnt && slot == BITMAP_ERROR; i++) {
+			c = (start + i) % swap_cluster_cnt;
+			if (swap_cluster_free[c] == SWAP_CLUSTER_SLOTS)
+				slot = c * SWAP_CLUSTER_SLOTS;
+		}
+		// 없다면 빈 slot이 하나라도 있는 cluster 안에서 찾음
+		for (i = 0; i < swap_cluster_cnt && slot == BITMAP_ERROR; i++) {
+			c = (start + i) % swap_cluster_cnt;
+			if (swap_cluster_free[c] > 0)
+				slot = bitmap_scan (swap_table, c * SWAP_CLUSTER_SLOTS, 1, false);
+		}
+	}
+
+	if (slot != BITMAP_ERROR) {
+		bitmap_mark (swap_table, slot);
+		swap_cluster_free[slot / SWAP_CLUSTER_SLOTS]--;
+		swap_free_cnt--;
+		swap_cursor = slot + 1;
+	}
+done:
+	lock_release (&swap_lock);
+	return slot;
+}
+
+/* Returns SLOT to the swap allocator. */
+static void
+swap_slot_free (size_t slot) {
+	lock_acquire (&swap_lock);
+	ASSERT (bitmap_test (swap_table, slot));
+	bitmap_reset (swap_table, slot);
+	swap_cluster_free[slot / SWAP_CLUSTER_SLOTS]++;
+	swap_free_cnt++;
+	lock_release (&swap_lock);
 }
 
 /* Swap in the page by read contents from the swap disk. */
@@ -50,40 +153,61 @@ static bool
 anon_swap_in (struct page *page, void *kva) {
 	struct anon_page *anon_page = &page->anon; // anon_page에 page->anon 주소를 연결하고
 
+	if (zswap_load (page, kva)) // zswap pool에 압축되어 있으면 disk를 읽을 필요가 없음
+		return true;
+
 	int page_no = anon_page->swap_index; // swap_index - 몇번째 swap data랑 바꿀것인지
-	if(bitmap_test(swap_table, page_no) == false) // swap_talbe(전역변수) 에서 page_no를 bit로 찾을건데 없으면 false 있으면 해당 index를 return함
+	if (page_no == SWAP_SLOT_NONE) { // 어디에도 내용이 없다면 madvise(DONTNEED)로 버려진 page -- 0으로 시작함
+		memset (kva, 0, PGSIZE);
+		return true;
+	}
+	if (bitmap_test(swap_table, page_no) == false) // swap_talbe(전역변수) 에서 page_no를 bit로 찾을건데 없으면 false 있으면 해당 index를 return함
 		return false;
 	
-	for ( int i = 0; i < SECTORS_PER_PAGE; i++){
+	for (size_t i = 0; i < SECTORS_PER_PAGE; i++){
 		disk_read(swap_disk, page_no*SECTORS_PER_PAGE+ i, kva + DISK_SECTOR_SIZE* i);
 		//swap disk에서 page_no*SECOTRS_PER_PAGE+ i sec를 kva+DISK_SECTOR_SIZE* i 만큼 읽음
 	}
 
-	bitmap_set(swap_table, page_no, false);
-	// page_no을 index로 swap_table 안에 설정함
-
+	swap_slot_free (page_no); // 다 읽었으니 slot을 반납함
+	anon_page->swap_index = SWAP_SLOT_NONE;
 
 	return true;
 }
 
-/* Swap out the page by writing contents to the swap disk. */
-static bool
-anon_swap_out (struct page *page) {
+/* Writes the page contents at KVA to a free swap slot and records the
+ * slot in PAGE.  Also used by zswap to write back compressed pages. */
+bool
+anon_swap_write (struct page *page, const void *kva) {
 	struct anon_page *anon_page = &page->anon;
 
-	/* for project 3 - start */
-	int page_no = bitmap_scan(swap_table, 0, 1, false); // swap_table에 value로 설정된 애들중 첫번째 index를 반환
+	size_t page_no = swap_slot_alloc (); // cursor 근처의 빈 slot을 할당 받음
 	if(page_no == BITMAP_ERROR)
 		return false;
 
-	for (int i = 0; i < SECTORS_PER_PAGE; i++){
-		disk_write(swap_disk, page_no*SECTORS_PER_PAGE+ i, page->va + DISK_SECTOR_SIZE* i);
+	for (size_t i = 0; i < SECTORS_PER_PAGE; i++){
+		disk_write(swap_disk, page_no*SECTORS_PER_PAGE+ i, kva + DISK_SECTOR_SIZE* i);
 		//swap disk로 page_no*SECOTRS_PER_PAGE+ i sec를 kva+DISK_SECTOR_SIZE* i 만큼 씀
 	}
 
-	bitmap_set (swap_table, page_no, true);
-	pml4_clear_page(thread_current() -> pml4, page->va);
 	anon_page->swap_index = page_no;
+	return true;
+}
+
+/* Swap out the page by writing contents to the swap disk. */
+static bool
+anon_swap_out (struct page *page) {
+	/* for project 3 - start */
+	uint64_t *pml4 = page_pml4 (page); // kswapd 나 다른 process가 내보낼 수도 있으니 page 주인의 pml4를 씀
+	void *kva = page->frame->kva;
+
+	if (!pml4_clear_page(pml4, page->va)) // 주인은 계속 돌고 있을 수 있으니 복사하기 전에 매핑부터 지워서 그 뒤의 쓰기는 fault가 나게 함
+		return false; // 2MB 매핑을 쪼갤 page table을 못 구했으면 이 page는 건너뜀
+	if (!zswap_store (page, kva) // 먼저 압축해서 메모리에 보관해보고
+	    && !anon_swap_write (page, kva)) { // 안되면 swap disk에 씀
+		pml4_set_page (pml4, page->va, kva, page->writable); // 둘 다 가득 차서 내보내지 못했으니 다시 매핑함
+		return false;
+	}
 
 	return true;
 	/* for project 3 - end */
@@ -93,4 +217,15 @@ anon_swap_out (struct page *page) {
 static void
 anon_destroy (struct page *page) {
 	struct anon_page *anon_page = &page->anon;
+
+	if (anon_page->ksm != NULL) { // pml4_destroy 가 공유 frame을 free 하지 않도록 매핑을 먼저 풀어줌
+		if (thread_current ()->pml4 != NULL)
+			pml4_clear_page (thread_current ()->pml4, page->va);
+		ksm_unmerge (page);
+	}
+	zswap_invalidate (page); // 압축되어 있던 page라면 pool에서 빼줌
+	if (anon_page->swap_index != SWAP_SLOT_NONE) { // swap disk에 남아있던 page라면 slot을 돌려줌
+		swap_slot_free (anon_page->swap_index);
+		anon_page->swap_index = SWAP_SLOT_NONE;
+	}
 }
@@ -1,14 +1,49 @@
 /* file.c: Implementation of memory backed file object (mmaped object). */
 
 #include "vm/vm.h"
+#include <round.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include "threads/vaddr.h"
 #include "threads/mmu.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "devices/timer.h"
 #include "userprog/process.h"
 
 static bool file_backed_swap_in (struct page *page, void *kva);
 static bool file_backed_swap_out (struct page *page);
 static void file_backed_destroy (struct page *page);
 
+/* Writeback of dirty mmapped pages.
+ * writeback thread가 주기적으로 frame table을 훑어서 dirty한 file page들을 모으고,
+ * file 안에서 이어지는 page들은 buffer에 모아서 한번의 file_write_at 으로 씀.
+ * msync 와 munmap 도 같은 방식으로 씀.
+ * page를 모을 때만 frame_lock 을 잡고, 모은 frame에는 writeback 표시를 해서
+ * 쓰는 동안 evict 되지 않게 함. file_write_at 은 frame_lock 없이 하므로 그동안
+ * 다른 page fault가 막히지 않음. 여러 writeback이 같은 page를 순서가 뒤바뀌어
+ * 쓰지 않도록 writeback 전체는 wb_lock 으로 한번에 하나씩만 함.
+ * evict 되는 page도 vm_evict 가 같은 writeback 표시를 하고 frame_lock 을 놓은 뒤에
+ * file_backed_swap_out 을 부르므로, 그 file_write_at 도 frame_lock 없이 함. */
+#define WB_BATCH_PAGES 16   /* 이어서 한번에 쓰는 최대 page 수 */
+#define WB_SCAN_PAGES 32    /* frame_lock 을 한번 잡고 모으는 최대 page 수 */
+
+/* writeback 주기 (초), 0이면 writeback thread를 만들지 않음 (-wb=N) */
+size_t vm_writeback_secs = 5;
+
+/* 써야할 dirty page 하나 */
+struct wb_page {
+	struct page *page;
+	uint64_t *pml4;          /* page가 매핑되어 있는 pml4 */
+};
+
+static struct lock wb_lock;        /* writeback 을 한번에 하나씩만 하게 함 */
+static uint64_t wb_pages_written;  /* writeback 한 page 수 */
+static uint64_t wb_writes;         /* 그걸 위해 부른 file_write_at 횟수 */
+
+static void writeback_thread (void *aux);
+
 /* DO NOT MODIFY this struct */
 static const struct page_operations file_ops = {
 	.swap_in = file_backed_swap_in,
@@ -20,6 +55,185 @@ static const struct page_operations file_ops = {
 /* The initializer of file vm */
 void
 vm_file_init (void) {
+	lock_init (&wb_lock);
+}
+
+/* Starts the periodic writeback thread.  Called once the frame table
+ * is ready. */
+void
+file_writeback_init (void) {
+	if (vm_writeback_secs > 0)
+		thread_create ("writeback", PRI_DEFAULT, writeback_thread, NULL);
+}
+
+/* Orders wb_pages by file, then by offset inside the file. */
+static int
+wb_page_cmp (const void *a_, const void *b_) {
+	const struct container *a = ((const struct wb_page *) a_)->page->uninit.aux;
+	const struct container *b = ((const struct wb_page *) b_)->page->uninit.aux;
+	struct inode *ia = file_get_inode (a->file);
+	struct inode *ib = file_get_inode (b->file);
+
+	if (ia != ib)
+		return ia < ib ? -1 : 1;
+	return a->offset < b->offset ? -1 : a->offset > b->offset;
+}
+
+/* Returns true if B continues A in the same file, so both can be
+ * written with a single file_write_at(). */
+static bool
+wb_adjacent (const struct wb_page *a, const struct wb_page *b) {
+	const struct container *aa = a->page->uninit.aux;
+	const struct container *ba = b->page->uninit.aux;
+
+	return file_get_inode (aa->file) == file_get_inode (ba->file)
+	       && aa->read_byte == PGSIZE && aa->offset + PGSIZE == ba->offset;
+}
+
+/* Returns true if PAGE is a resident file page with unsaved changes
+ * in PML4 that is not being written back already. */
+static bool
+wb_dirty (struct page *page, uint64_t *pml4) {
+	return page->operations->type == VM_FILE && page->frame != NULL
+	       && !page->frame->writeback && pml4_is_dirty (pml4, page->va);
+}
+
+/* Adds PAGE, a wb_dirty() page mapped in PML4, as the CNT'th entry
+ * of PAGES and keeps its frame from being evicted until wb_flush()
+ * is done with it.  Must hold frame_lock. */
+static void
+wb_add (struct wb_page *pages, size_t cnt, struct page *page, uint64_t *pml4) {
+	pages[cnt].page = page;
+	pages[cnt].pml4 = pml4;
+	page->frame->writeback = true;
+}
+
+/* Writes back the CNT dirty file pages in PAGES, collected with
+ * wb_add(), and clears their dirty bits.  Pages that are adjacent in
+ * their file are gathered into one buffer and written at once.  Must
+ * hold wb_lock but not frame_lock: the frames cannot be evicted while
+ * they are marked, nor unmapped while wb_lock is held. */
+static void
+wb_flush (struct wb_page *pages, size_t cnt) {
+	uint8_t *buf;
+	size_t i = 0;
+
+	if (cnt == 0)
+		return;
+	buf = palloc_get_multiple (0, WB_BATCH_PAGES); // 없으면 page 하나씩 씀
+	qsort (pages, cnt, sizeof *pages, wb_page_cmp);
+	while (i < cnt) {
+		struct container *first = pages[i].page->uninit.aux;
+		size_t run = 1, length = 0;
+
+		if (buf != NULL)
+			while (i + run < cnt && run < WB_BATCH_PAGES
+			       && wb_adjacent (&pages[i + run - 1], &pages[i + run]))
+				run++;
+
+		for (size_t k = i; k < i + run; k++) {
+			struct page *page = pages[k].page;
+			struct container *aux = page->uninit.aux;
+
+			pml4_set_dirty (pages[k].pml4, page->va, false); // 복사하기 전에 지워야 그 사이에 쓴 내용도 다음에 다시 써짐
+			if (buf != NULL)
+				memcpy (buf + length, page->frame->kva, aux->read_byte);
+			length += aux->read_byte;
+		}
+		file_write_at (first->file, buf != NULL ? buf : pages[i].page->frame->kva,
+		               length, first->offset);
+		wb_writes++;
+		wb_pages_written += run;
+		i += run;
+	}
+	palloc_free_multiple (buf, WB_BATCH_PAGES);
+
+	lock_acquire (&frame_lock); // 다 썼으니 다시 evict 될 수 있음
+	for (i = 0; i < cnt; i++)
+		vm_writeback_end (pages[i].page->frame);
+	lock_release (&frame_lock);
+}
+
+/* Writes back the dirty file pages among the PAGE_CNT pages of the
+ * current process starting at ADDR. */
+static void
+writeback_range (void *addr, size_t page_cnt) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct wb_page pages[WB_SCAN_PAGES];
+	size_t i = 0;
+
+	lock_acquire (&wb_lock);
+	while (i < page_cnt) {
+		size_t cnt = 0;
+
+		lock_acquire (&frame_lock);
+		for (; i < page_cnt && cnt < WB_SCAN_PAGES; i++) {
+			struct page *page = spt_find_page (spt, addr + i * PGSIZE);
+			if (page != NULL && wb_dirty (page, pml4))
+				wb_add (pages, cnt++, page, pml4);
+		}
+		lock_release (&frame_lock);
+		wb_flush (pages, cnt);
+	}
+	lock_release (&wb_lock);
+}
+
+/* Writes the modified pages of the file mappings in [ADDR, ADDR +
+ * LENGTH) back to their files.  Returns false, writing nothing, if
+ * any page of the range is not mapped. */
+bool
+do_msync (void *addr, size_t length) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	size_t page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+	for (size_t i = 0; i < page_cnt; i++)
+		if (spt_find_page (spt, addr + i * PGSIZE) == NULL)
+			return false;
+	writeback_range (addr, page_cnt);
+	return true;
+}
+
+/* Every vm_writeback_secs seconds, writes back the dirty file pages
+ * of all processes, WB_SCAN_PAGES at a time.  frame_lock is only
+ * held while the pages are collected, so page faults are not held up
+ * by the writes. */
+static void
+writeback_thread (void *aux UNUSED) {
+	struct wb_page pages[WB_SCAN_PAGES];
+
+	for (;;) {
+		size_t cnt;
+
+		timer_sleep (vm_writeback_secs * TIMER_FREQ);
+		lock_acquire (&wb_lock);
+		do {
+			struct list_elem *e;
+
+			cnt = 0;
+			lock_acquire (&frame_lock);
+			for (e = list_begin (&frame_table); e != list_end (&frame_table) && cnt < WB_SCAN_PAGES;
+			     e = list_next (e)) {
+				struct frame *frame = list_entry (e, struct frame, elem_fr);
+				if (frame->writeback) // 내보내는 중이거나 ksm scan 위치 표시임
+					continue;
+				struct page *page = frame->page;
+				uint64_t *pml4 = page_pml4 (page);
+				if (wb_dirty (page, pml4))
+					wb_add (pages, cnt++, page, pml4);
+			}
+			lock_release (&frame_lock);
+			wb_flush (pages, cnt); // 쓰고 나면 clean 해지니 다음 바퀴에는 남은 page들이 잡힘
+		} while (cnt == WB_SCAN_PAGES);
+		lock_release (&wb_lock);
+	}
+}
+
+/* Prints writeback statistics. */
+void
+file_print_stats (void) {
+	if (wb_pages_written > 0)
+		printf ("Writeback: %llu pages in %llu writes\n", wb_pages_written, wb_writes);
 }
 
 /* Initialize the file backed page */
@@ -55,7 +269,10 @@ file_backed_swap_in (struct page *page, void *kva) {
 	return true;
 }
 
-/* Swap out the page by writeback contents to the file. */
+/* Swap out the page by writeback contents to the file.  Called
+ * without frame_lock, with the frame marked writeback (see
+ * vm_evict()).  Returns false, leaving the page mapped and dirty, if
+ * the file cannot take the whole page. */
 static bool
 file_backed_swap_out (struct page *page) {
 	struct file_page *file_page UNUSED = &page->file;
@@ -64,12 +281,20 @@ file_backed_swap_out (struct page *page) {
 		return false;
 	
 	struct container *aux = (struct container *)page->uninit.aux;
+	uint64_t *pml4 = page_pml4(page); // 다른 thread가 내보낼 수도 있으니 page 주인의 pml4를 써야함
+	void *kva = page->frame->kva;
 
-	if(pml4_is_dirty(thread_current()->pml4, page->va)){
-		file_write_at(aux->file, page->va, aux->read_byte, aux->offset);
-		pml4_set_dirty(thread_current()->pml4, page->va, 0);
+	if (!pml4_clear_page(pml4, page->va)) // 쓰는 동안 주인이 수정한 내용이 사라지지 않도록 매핑부터 지움 (dirty bit은 남아있음)
+		return false;
+	if(pml4_is_dirty(pml4, page->va)){
+		if (file_write_at(aux->file, kva, aux->read_byte, aux->offset) != (off_t) aux->read_byte) { // 주인의 주소 공간이 아닐 수 있으니 kva로 씀
+			pml4_set_page(pml4, page->va, kva, page->writable); // 다 쓰지 못했으면 내용을 버리지 않고 다시 매핑함
+			pml4_set_dirty(pml4, page->va, true); // 다음에 다시 써야 함
+			return false;
+		}
+		pml4_set_dirty(pml4, page->va, 0);
 	}
-	pml4_clear_page(thread_current()->pml4, page->va);
+	return true;
 }
 
 /* Destory the file backed page. PAGE will be freed by the caller. */
@@ -114,20 +339,64 @@ do_mmap (void *addr, size_t length, int writable, struct file *file, off_t offse
 /* Do the munmap */
 void
 do_munmap (void *addr) {
-	while (true){
-		struct page *page_ = spt_find_page(&thread_current()->spt, addr); // 해당 address에 맞는 page를 찾음
+	struct tlb_gather tlb;
+
+	tlb_gather_init (&tlb, thread_current ()->pml4);
+	do_munmap_gather (addr, &tlb);
+	tlb_gather_finish (&tlb); // 지운 page들의 TLB entry를 한번에 무효화함
+}
 
-		if(page_ == NULL) // page가 NULL이면 할 필요가 없으니깐
+/* Returns where in its file PAGE lives if PAGE belongs to a file
+ * mapping, loaded or not; otherwise returns NULL. */
+static struct container *
+mmap_region (struct page *page) {
+	if (page == NULL || page_get_type (page) != VM_FILE)
+		return NULL;
+	return page->uninit.aux;
+}
+
+/* Returns the number of pages of the mapping at ADDR, counting from
+ * ADDR: the pages that follow it while they map the same file at
+ * consecutive offsets.  Pages of other mappings, anonymous or stack
+ * pages right behind the mapping are not part of it. */
+static size_t
+mmap_page_cnt (struct supplemental_page_table *spt, void *addr) {
+	struct container *prev = mmap_region (spt_find_page (spt, addr));
+	size_t cnt;
+
+	if (prev == NULL)
+		return 0;
+	for (cnt = 1; ; cnt++) {
+		struct container *next = mmap_region (spt_find_page (spt, addr + cnt * PGSIZE));
+		if (next == NULL || next->file != prev->file // mmap 마다 file을 reopen 하니 다른 매핑이면 file이 다름
+		    || next->offset != prev->offset + (off_t) prev->read_byte)
 			break;
+		prev = next;
+	}
+	return cnt;
+}
 
-		struct container * aux = (struct container *) page_->uninit.aux; // page_의 aux를 형변환 한다 -- 내부 데이터를 다 지울거야
+/* Unmaps the mapping at ADDR like do_munmap(), collecting the TLB
+ * invalidations in TLB instead of issuing them page by page. */
+void
+do_munmap_gather (void *addr, struct tlb_gather *tlb) {
+	struct supplemental_page_table *spt = &thread_current()->spt;
+	struct page *first = spt_find_page(spt, addr);
+	if (first != NULL && first->operations->type == VM_SHM) { // 공유 memory 매핑이면 file과 상관이 없음
+		shm_unmap_gather(addr, tlb);
+		return;
+	}
 
-		if(pml4_is_dirty(thread_current()->pml4, page_->va)){ // pml4 의 가상페이지에 page_->va 가 dirty 인 경우 (즉, page_->va 가 설치된 후 페이지가 수정된 경우 true를 반환)
-			file_write_at(aux->file, addr, aux->read_byte, aux->offset); // addr에 있는 정보를 aux->offset부터 read_byte만큼 aux->file에 씁니다
-			pml4_set_dirty(thread_current()->pml4, page_->va, 0); // pml4 의 가상페이지에 있는 page_->va의 dirty 비트를 dirty 로 설정
-		}
+	size_t page_cnt = mmap_page_cnt(spt, addr); // 매핑에 속한 page들만 지움
+	writeback_range(addr, page_cnt); // 매핑을 지우기 전에 수정된 내용을 이어진 page끼리 모아서 file에 써줌
+
+	for (size_t i = 0; i < page_cnt; i++){
+		struct page *page_ = spt_find_page(spt, addr + i * PGSIZE); // 해당 address에 맞는 page를 찾음
+		struct container *aux = page_->uninit.aux;
 
-		pml4_clear_page(thread_current()->pml4, page_->va); // pml4 에 존재하는 page_->va를 존재하지 않음으로 표기함 --> 추후에 접근하려고 하면 error 가 발생함
-		addr +=PGSIZE; // page를 지운 후 addr를 다음 page의 시작지점으로 옮김
+		pml4_clear_page_gather(tlb, page_->va); // pml4 에 존재하는 page_->va를 존재하지 않음으로 표기함 --> TLB 무효화는 tlb에 모아뒀다가 한번에 함
+		vm_frame_free(page_); // 매핑이 없어졌으니 frame도 돌려줌 (resident 개수에서도 빠짐) -- 내보내는 중이면 끝날 때까지 기다림
+		spt_remove_page(spt, page_); // 다음 fault에서 다시 올라오지 않도록 spt에서도 지움
+		free(aux);
 	}
 }
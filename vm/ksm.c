@@ -0,0 +1,355 @@
+/* ksm.c: Kernel same-page merging for anonymous pages.
+ *
+ * ksmd thread가 주기적으로 frame table의 anonymous page들을 hash_bytes로 훑어서
+ * 내용이 byte 단위로 똑같은 page들을 찾고, 하나의 공유 frame (ksm node)을
+ * read-only로 같이 매핑하게 한 뒤 나머지 frame들은 돌려줌. 합쳐진 page에 쓰기가
+ * 일어나면 vm_handle_wp 에서 private frame으로 복사해서 떼어냄 (copy-on-write).
+ *
+ * 지난 scan과 checksum이 다른 page는 자주 바뀌는 page로 보고 다음 scan까지
+ * 합치지 않음. 이미 있는 공유 frame과 같은 page는 그 frame에 붙이고 (stable),
+ * 아직 공유 frame이 없는 내용은 이번 scan 안에서만 쓰는 table (unstable)에서
+ * 짝을 찾음. 공유 frame은 frame table에 들어가지 않으므로 evict 되지 않음.
+ *
+ * scan은 frame table을 KSM_SCAN_PAGES 개씩 나눠서 훑음. 한 batch의 frame들은
+ * writeback 표시로 붙잡아둔 채 lock 없이 hash 하고, 비교와 매핑을 바꿀 때만
+ * frame_lock을 다시 잡으므로 그동안 다른 fault와 frame 할당이 막히지 않음. */
+
+#include "vm/ksm.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/vm.h"
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "devices/timer.h"
+
+/* 여러 page가 같이 매핑하는 공유 frame 하나 */
+struct ksm_node {
+	void *kva;               /* 공유 frame */
+	uint64_t sum;            /* 내용의 hash_bytes */
+	size_t ref_cnt;          /* 이 frame을 매핑하고 있는 page 수 */
+	struct hash_elem elem;   /* ksm_nodes 의 원소 */
+};
+
+/* Frames hashed in one batch of a scan, with frame_lock released. */
+#define KSM_SCAN_PAGES 32
+
+size_t ksm_scan_secs = 0;
+
+static struct lock ksm_lock;       /* ksm_nodes, node 정보와 anon_page.ksm 을 보호함 */
+static struct hash ksm_nodes;      /* 내용으로 찾는 모든 공유 frame */
+static struct hash unstable;       /* 이번 scan에서 아직 짝을 찾지 못한 frame들, frame_lock 으로 보호함 */
+
+/* scan이 frame table의 어디까지 훑었는지 표시하는 가짜 frame.  writeback
+ * 표시가 되어 있어서 frame table을 훑는 다른 곳에서는 건너뜀. */
+static struct frame ksm_cursor;
+
+/* 통계 */
+static size_t stat_nodes;          /* 지금 있는 공유 frame 수 */
+static size_t stat_sharing;        /* 공유 frame을 매핑하고 있는 page 수 */
+static uint64_t stat_merged;       /* 지금까지 합친 page 수 */
+static uint64_t stat_unmerged;     /* 쓰기 등으로 다시 떼어낸 page 수 */
+static uint64_t stat_scans;        /* 끝난 scan 수 */
+
+static void ksmd (void *aux);
+
+/* Hashes a ksm_node by its contents. */
+static uint64_t
+node_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct ksm_node, elem)->sum;
+}
+
+/* Orders ksm_nodes by checksum, then by contents, so that nodes
+ * compare equal only if they hold the same bytes. */
+static bool
+node_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct ksm_node *a = hash_entry (a_, struct ksm_node, elem);
+	const struct ksm_node *b = hash_entry (b_, struct ksm_node, elem);
+
+	if (a->sum != b->sum)
+		return a->sum < b->sum;
+	return memcmp (a->kva, b->kva, PGSIZE) < 0;
+}
+
+/* Hashes a frame of the unstable table by the checksum of its
+ * contents taken by the scan. */
+static uint64_t
+unstable_hash (const struct hash_elem *e, void *aux UNUSED) {
+	return hash_entry (e, struct frame, ksm_elem)->ksm_sum;
+}
+
+/* Orders frames of the unstable table by checksum only.  Their
+ * contents may change between batches, so comparing bytes here could
+ * lose a frame in ksm_forget(); ksm_merge_pair() compares the bytes
+ * before merging anyway.  At most one frame per checksum is kept. */
+static bool
+unstable_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct frame *a = hash_entry (a_, struct frame, ksm_elem);
+	const struct frame *b = hash_entry (b_, struct frame, ksm_elem);
+
+	return a->ksm_sum < b->ksm_sum;
+}
+
+/* Marks a frame as no longer in the unstable table. */
+static void
+unstable_clear (struct hash_elem *e, void *aux UNUSED) {
+	hash_entry (e, struct frame, ksm_elem)->ksm_unstable = false;
+}
+
+/* Initializes same-page merging and starts ksmd if it is enabled. */
+void
+ksm_init (void) {
+	lock_init (&ksm_lock);
+	hash_init (&ksm_nodes, node_hash, node_less, NULL);
+	ksm_cursor.writeback = true;
+	if (ksm_scan_secs > 0 && hash_init (&unstable, unstable_hash, unstable_less, NULL))
+		thread_create ("ksmd", PRI_MIN, ksmd, NULL);
+}
+
+/* Removes FRAME, which is leaving the frame table, from the unstable
+ * table of the running scan.  Must hold frame_lock. */
+void
+ksm_forget (struct frame *frame) {
+	struct hash_elem *found;
+
+	ASSERT (frame->ksm_unstable);
+	found = hash_delete (&unstable, &frame->ksm_elem);
+	ASSERT (found == &frame->ksm_elem);
+	frame->ksm_unstable = false;
+}
+
+/* Returns the shared frame mapped by PAGE, or NULL if PAGE has not
+ * been merged. */
+void *
+ksm_page_kva (struct page *page) {
+	if (page->operations->type != VM_ANON || page->anon.ksm == NULL)
+		return NULL;
+	return page->anon.ksm->kva;
+}
+
+/* Maps NODE's frame read-only at the address of PAGE, the page held
+ * by FRAME, instead of FRAME, if both still hold the same bytes.
+ * Interrupts must be off so that the owner cannot write the page
+ * between the comparison and the switch.  Must hold frame_lock and
+ * ksm_lock. */
+static bool
+ksm_map (struct ksm_node *node, struct frame *frame, uint64_t *pml4) {
+	struct page *page = frame->page;
+
+	ASSERT (intr_get_level () == INTR_OFF);
+	if (node->kva != frame->kva && memcmp (node->kva, frame->kva, PGSIZE) != 0)
+		return false;
+
+	pml4_clear_page (pml4, page->va); // 이전 frame의 TLB entry를 지우고
+	pml4_set_page (pml4, page->va, node->kva, false); // 쓰면 fault가 나서 떼어낼 수 있도록 read-only로 매핑
+	page->anon.ksm = node;
+	page->frame = NULL;
+	frame->owner->ksm_cnt++;
+	node->ref_cnt++;
+	stat_sharing++;
+	stat_merged++;
+	return true;
+}
+
+/* Merges the page held by FRAME into NODE and frees FRAME.  Returns
+ * false, changing nothing, if the contents differ.  Must hold
+ * frame_lock and ksm_lock. */
+static bool
+ksm_merge (struct ksm_node *node, struct frame *frame) {
+	uint64_t *pml4 = page_pml4 (frame->page);
+	enum intr_level old_level;
+	bool merged;
+
+	if (!pml4_split_huge_page (pml4, frame->page->va)) // 2MB 매핑 안의 page면 먼저 4KB로 쪼갬
+		return false;
+	old_level = intr_disable ();
+	merged = ksm_map (node, frame, pml4);
+	intr_set_level (old_level);
+	if (!merged)
+		return false;
+
+	vm_frame_detach (frame);
+	palloc_free_page (frame->kva);
+	free (frame);
+	return true;
+}
+
+/* Turns the frames of the pages held by FIRST and SECOND, which had
+ * the same checksum in this and the previous scan, into a new shared
+ * frame if their contents are the same.  FIRST's physical page
+ * becomes the shared frame.  Must hold frame_lock and ksm_lock. */
+static void
+ksm_merge_pair (struct frame *first, struct frame *second, uint64_t sum) {
+	uint64_t *pml4_first = page_pml4 (first->page);
+	uint64_t *pml4_second = page_pml4 (second->page);
+	struct ksm_node *node = malloc (sizeof *node);
+	enum intr_level old_level;
+	bool merged = false;
+
+	if (node == NULL)
+		return;
+	if (!pml4_split_huge_page (pml4_first, first->page->va)
+	    || !pml4_split_huge_page (pml4_second, second->page->va)) {
+		free (node);
+		return;
+	}
+
+	node->kva = first->kva;
+	node->sum = sum;
+	node->ref_cnt = 0;
+	old_level = intr_disable (); // 두 page를 비교하고 매핑을 바꾸는 동안 어느 쪽도 쓰지 못하게 함
+	if (memcmp (first->kva, second->kva, PGSIZE) == 0) {
+		ksm_map (node, first, pml4_first);
+		ksm_map (node, second, pml4_second);
+		merged = true;
+	}
+	intr_set_level (old_level);
+	if (!merged) {
+		free (node);
+		return;
+	}
+
+	hash_insert (&ksm_nodes, &node->elem);
+	stat_nodes++;
+	vm_frame_detach (first);
+	free (first); // physical page는 공유 frame이 됨
+	vm_frame_detach (second);
+	palloc_free_page (second->kva);
+	free (second);
+}
+
+/* Pins up to KSM_SCAN_PAGES frames of anonymous pages that follow
+ * the scan cursor into FRAMES, marking them writeback so that they
+ * are neither evicted nor freed while they are hashed, and moves the
+ * cursor past them.  Returns the number of frames pinned.  Must hold
+ * frame_lock. */
+static size_t
+ksm_collect (struct frame **frames) {
+	struct list_elem *e = list_next (&ksm_cursor.elem_fr);
+	size_t cnt = 0;
+
+	for (; e != list_end (&frame_table) && cnt < KSM_SCAN_PAGES; e = list_next (e)) {
+		struct frame *frame = list_entry (e, struct frame, elem_fr);
+		if (frame->writeback || frame->page->operations->type != VM_ANON) // 내보내는 중인 frame은 건드리지 않음
+			continue;
+		frame->writeback = true;
+		frames[cnt++] = frame;
+	}
+	list_remove (&ksm_cursor.elem_fr);
+	list_insert (e, &ksm_cursor.elem_fr); // 다음 batch는 여기서부터
+	return cnt;
+}
+
+/* Merges the page held by FRAME, whose contents hashed to SUM, with
+ * a shared frame or with another page of this scan that has the same
+ * contents.  Must hold frame_lock and ksm_lock. */
+static void
+ksm_scan_frame (struct frame *frame, uint64_t sum) {
+	struct page *page = frame->page;
+	struct hash_elem *found;
+	struct frame *twin;
+
+	if (sum != page->anon.ksm_sum) { // 지난 scan 이후에 바뀐 page는 다시 바뀔 가능성이 높으니 다음 scan까지 기다림
+		page->anon.ksm_sum = sum;
+		return;
+	}
+
+	struct ksm_node key = { .kva = frame->kva, .sum = sum };
+	found = hash_find (&ksm_nodes, &key.elem);
+	if (found != NULL) { // 같은 내용의 공유 frame이 이미 있음
+		ksm_merge (hash_entry (found, struct ksm_node, elem), frame);
+		return;
+	}
+
+	frame->ksm_sum = sum;
+	found = hash_insert (&unstable, &frame->ksm_elem);
+	if (found == NULL) {
+		frame->ksm_unstable = true;
+		return;
+	}
+	twin = hash_entry (found, struct frame, ksm_elem); // 이번 scan에서 같은 내용의 page를 이미 봤음
+	if (twin->writeback) // 그 사이에 내보내는 중이 되었으면 다음 scan에서 다시 봄
+		return;
+	ksm_forget (twin);
+	ksm_merge_pair (twin, frame, sum);
+}
+
+/* Walks the frame table once and merges the anonymous pages with
+ * identical contents, KSM_SCAN_PAGES frames at a time. */
+static void
+ksm_scan (void) {
+	struct frame *frames[KSM_SCAN_PAGES];
+	uint64_t sums[KSM_SCAN_PAGES];
+	size_t cnt, i;
+
+	lock_acquire (&frame_lock);
+	list_push_front (&frame_table, &ksm_cursor.elem_fr);
+	while ((cnt = ksm_collect (frames)) > 0) {
+		lock_release (&frame_lock); // hash 하는 동안 다른 fault와 frame 할당을 막지 않음
+		for (i = 0; i < cnt; i++)
+			sums[i] = hash_bytes (frames[i]->kva, PGSIZE);
+
+		lock_acquire (&frame_lock);
+		lock_acquire (&ksm_lock);
+		for (i = 0; i < cnt; i++) {
+			vm_writeback_end (frames[i]);
+			ksm_scan_frame (frames[i], sums[i]);
+		}
+		lock_release (&ksm_lock);
+	}
+	list_remove (&ksm_cursor.elem_fr);
+	hash_clear (&unstable, unstable_clear);
+	stat_scans++;
+	lock_release (&frame_lock);
+}
+
+/* Same-page merging thread.  Scans all frames every ksm_scan_secs
+ * seconds, at the lowest priority. */
+static void
+ksmd (void *aux UNUSED) {
+	for (;;) {
+		timer_sleep (ksm_scan_secs * TIMER_FREQ);
+		ksm_scan ();
+	}
+}
+
+/* Detaches PAGE, a page of the current process, from its shared
+ * frame.  The caller must already have removed the mapping; the
+ * shared frame is freed with its last page. */
+void
+ksm_unmerge (struct page *page) {
+	struct ksm_node *node = page->anon.ksm;
+
+	ASSERT (node != NULL);
+	lock_acquire (&ksm_lock);
+	page->anon.ksm = NULL;
+	thread_current ()->spt.ksm_cnt--;
+	stat_sharing--;
+	stat_unmerged++;
+	if (--node->ref_cnt == 0) {
+		hash_delete (&ksm_nodes, &node->elem);
+		stat_nodes--;
+		palloc_free_page (node->kva);
+		free (node);
+	}
+	lock_release (&ksm_lock);
+}
+
+/* Prints same-page merging statistics. */
+void
+ksm_print_stats (void) {
+	if (stat_merged == 0)
+		return;
+
+	printf ("KSM: %zu pages share %zu frames (%zu KiB saved), "
+	        "%"PRIu64" merged, %"PRIu64" unmerged in %"PRIu64" scans\n",
+	        stat_sharing, stat_nodes, (stat_sharing - stat_nodes) * PGSIZE / 1024,
+	        stat_merged, stat_unmerged, stat_scans);
+}
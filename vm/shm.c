@@ -0,0 +1,300 @@
+/* shm.c: Shared memory objects mapped into several processes.
+ *
+ * shm 객체는 이름과 크기를 가진 anonymous memory로, 자기 frame들을 직접
+ * 가지고 있음. 객체를 매핑한 page (VM_SHM)는 private frame을 받지 않고 객체의
+ * frame을 그대로 매핑하므로 같은 객체를 매핑한 process들은 복사 없이 같은
+ * 물리 memory를 보게 됨. fork 할 때도 내용을 복사하지 않고 자식이 같은 객체를
+ * 매핑함.
+ *
+ * 객체의 frame은 처음 접근될 때 vm_get_pinned_page 로 할당되고 frame table에
+ * 들어가지 않으므로 evict 되지 않음. 그래서 객체의 크기와 할당된 frame의 총합은
+ * pinned frame의 한도 (vm_pinned_limit) 를 넘을 수 없음. 객체는 이름이 남아있거나 (shm_unlink 전) 매핑한 page가 하나라도
+ * 있는 동안 유지되고, 둘 다 없어지면 frame과 함께 해제됨. */
+
+#include "vm/shm.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <string.h>
+#include "vm/vm.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+static bool shm_swap_in (struct page *page, void *kva);
+static bool shm_swap_out (struct page *page);
+static void shm_destroy (struct page *page);
+
+/* DO NOT MODIFY this struct */
+static const struct page_operations shm_ops = {
+	.swap_in = shm_swap_in,
+	.swap_out = shm_swap_out,
+	.destroy = shm_destroy,
+	.type = VM_SHM,
+};
+
+/* 공유 memory 객체 하나 */
+struct shm_object {
+	int id;                      /* shm_open 이 돌려준 번호 */
+	char name[SHM_NAME_MAX + 1]; /* 이름, unlink 되면 빈 문자열 */
+	bool linked;                 /* 아직 이름으로 찾을 수 있는지 */
+	size_t page_cnt;             /* 크기 (page 단위) */
+	size_t ref_cnt;              /* 이 객체를 매핑하고 있는 page 수 */
+	void **kpages;               /* page 별 frame, 아직 할당 안됐으면 NULL */
+	struct list_elem elem;       /* shm_objects 의 원소 */
+};
+
+static struct lock shm_lock;       /* shm_objects 와 객체의 모든 정보를 보호함 */
+static struct list shm_objects;    /* 살아있는 모든 shm 객체 */
+static int shm_next_id;            /* 다음에 만들 객체의 id */
+
+/* Initializes the shared memory object table. */
+void
+shm_init (void) {
+	lock_init (&shm_lock);
+	list_init (&shm_objects);
+	shm_next_id = 1;
+}
+
+/* Returns the object called NAME, or NULL.  Must hold shm_lock. */
+static struct shm_object *
+shm_find_name (const char *name) {
+	struct list_elem *e;
+
+	for (e = list_begin (&shm_objects); e != list_end (&shm_objects); e = list_next (e)) {
+		struct shm_object *obj = list_entry (e, struct shm_object, elem);
+		if (obj->linked && strcmp (obj->name, name) == 0)
+			return obj;
+	}
+	return NULL;
+}
+
+/* Returns the object with ID, or NULL.  Must hold shm_lock. */
+static struct shm_object *
+shm_find_id (int id) {
+	struct list_elem *e;
+
+	for (e = list_begin (&shm_objects); e != list_end (&shm_objects); e = list_next (e)) {
+		struct shm_object *obj = list_entry (e, struct shm_object, elem);
+		if (obj->id == id)
+			return obj;
+	}
+	return NULL;
+}
+
+/* Frees OBJ if it can no longer be reached: it has no name and no
+ * page maps it.  Must hold shm_lock. */
+static void
+shm_release (struct shm_object *obj) {
+	if (obj->linked || obj->ref_cnt > 0)
+		return;
+
+	list_remove (&obj->elem);
+	for (size_t i = 0; i < obj->page_cnt; i++)
+		if (obj->kpages[i] != NULL)
+			vm_free_pinned_page (obj->kpages[i]);
+	free (obj->kpages);
+	free (obj);
+}
+
+/* Opens the object called NAME, creating it with SIZE bytes if it
+ * does not exist yet.  An existing object must be at least SIZE
+ * bytes large, a new one can be no larger than the frames that may
+ * be pinned.  Returns the id of the object, or -1 on failure. */
+int
+shm_open_object (const char *name, size_t size) {
+	struct shm_object *obj;
+	int id = -1;
+
+	if (strlen (name) == 0 || strlen (name) > SHM_NAME_MAX)
+		return -1;
+
+	lock_acquire (&shm_lock);
+	obj = shm_find_name (name);
+	if (obj != NULL) { // 이미 있는 객체면 요구한 크기를 담을 수 있을 때만 돌려줌
+		if (size <= obj->page_cnt * PGSIZE)
+			id = obj->id;
+	} else if (size > 0 && size <= vm_pinned_limit () * PGSIZE) { // evict 되지 않는 frame으로 user pool을 다 채우지 못하게 함
+		obj = calloc (1, sizeof *obj);
+		if (obj != NULL) {
+			obj->page_cnt = DIV_ROUND_UP (size, PGSIZE);
+			obj->kpages = calloc (obj->page_cnt, sizeof *obj->kpages); // frame은 처음 접근할 때 받음
+			if (obj->kpages != NULL) {
+				obj->id = id = shm_next_id++;
+				strlcpy (obj->name, name, sizeof obj->name);
+				obj->linked = true;
+				list_push_back (&shm_objects, &obj->elem);
+			} else
+				free (obj);
+		}
+	}
+	lock_release (&shm_lock);
+	return id;
+}
+
+/* Removes NAME from the object table.  The object itself lives on
+ * until the last page mapping it is gone.  Returns false if there
+ * is no such object. */
+bool
+shm_unlink_object (const char *name) {
+	struct shm_object *obj;
+
+	lock_acquire (&shm_lock);
+	obj = shm_find_name (name);
+	if (obj != NULL) {
+		obj->linked = false;
+		obj->name[0] = '\0';
+		shm_release (obj);
+	}
+	lock_release (&shm_lock);
+	return obj != NULL;
+}
+
+/* Adds a page at VA that maps page IDX of OBJ to the current
+ * process.  Must hold shm_lock. */
+static bool
+shm_add_page (struct shm_object *obj, size_t idx, void *va, bool writable) {
+	struct page *page;
+
+	if (!vm_alloc_page (VM_SHM, va, writable))
+		return false;
+
+	// 내용은 객체가 가지고 있으니 uninit 단계가 필요 없음 -- 바로 shm page로 바꿔줌
+	page = spt_find_page (&thread_current ()->spt, va);
+	page->operations = &shm_ops;
+	page->shm.obj = obj;
+	page->shm.idx = idx;
+	obj->ref_cnt++;
+	return true;
+}
+
+/* Maps the whole object ID at ADDR in the current process.  Returns
+ * ADDR, or NULL if the object does not exist or any page of the
+ * range is already in use. */
+void *
+shm_map_object (int id, void *addr, bool writable) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct shm_object *obj;
+	void *ret = NULL;
+	size_t i;
+
+	lock_acquire (&shm_lock);
+	obj = shm_find_id (id);
+	if (obj == NULL || !is_user_vaddr (addr + obj->page_cnt * PGSIZE - 1)
+	    || addr + obj->page_cnt * PGSIZE < addr)
+		goto done;
+	for (i = 0; i < obj->page_cnt; i++) // 범위 안에 이미 다른 page가 있으면 안됨
+		if (spt_find_page (spt, addr + i * PGSIZE) != NULL)
+			goto done;
+
+	for (i = 0; i < obj->page_cnt; i++)
+		if (!shm_add_page (obj, i, addr + i * PGSIZE, writable))
+			break;
+	if (i == obj->page_cnt)
+		ret = addr;
+	else
+		while (i-- > 0) { // 중간에 실패했으면 추가했던 page들을 되돌림
+			struct page *page = spt_find_page (spt, addr + i * PGSIZE);
+			hash_delete (&spt->pages, &page->elem_hash);
+			obj->ref_cnt--;
+			free (page);
+		}
+
+done:
+	lock_release (&shm_lock);
+	return ret;
+}
+
+/* Adds a page to the current process that maps the same frame as
+ * PARENT, a VM_SHM page of the parent process.  Used by fork. */
+bool
+shm_share_page (struct page *parent) {
+	bool success;
+
+	lock_acquire (&shm_lock);
+	success = shm_add_page (parent->shm.obj, parent->shm.idx, parent->va,
+	                        parent->writable);
+	lock_release (&shm_lock);
+	return success;
+}
+
+/* Maps the frame of the object page behind PAGE, allocating it on
+ * first use.  Returns false if no frame can be pinned for it. */
+bool
+shm_claim_page (struct page *page) {
+	struct shm_object *obj = page->shm.obj;
+	void *kpage, *fresh;
+
+	lock_acquire (&shm_lock);
+	kpage = obj->kpages[page->shm.idx];
+	lock_release (&shm_lock);
+	if (kpage == NULL) { // 아무도 아직 접근하지 않은 page -- frame을 받다가 evict 로 I/O를 할 수 있으니 lock 밖에서 받음
+		fresh = vm_get_pinned_page (); // 0으로 채워져서 옴
+		if (fresh == NULL)
+			return false;
+		lock_acquire (&shm_lock);
+		kpage = obj->kpages[page->shm.idx];
+		if (kpage == NULL)
+			kpage = obj->kpages[page->shm.idx] = fresh;
+		lock_release (&shm_lock);
+		if (kpage != fresh) // 받는 동안 다른 process가 먼저 채웠음
+			vm_free_pinned_page (fresh);
+	}
+
+	return pml4_set_page (thread_current ()->pml4, page->va, kpage, page->writable);
+}
+
+/* Removes the shared memory mapping that starts at ADDR from the
+ * current process, collecting the TLB invalidations in TLB. */
+void
+shm_unmap_gather (void *addr, struct tlb_gather *tlb) {
+	struct supplemental_page_table *spt = &thread_current ()->spt;
+	struct page *page = spt_find_page (spt, addr);
+	struct shm_object *obj = page != NULL ? page->shm.obj : NULL;
+	size_t idx = page != NULL ? page->shm.idx : 0;
+
+	// 같은 객체의 연속된 page가 나오는 동안 지움
+	while (page != NULL && page->operations->type == VM_SHM
+	       && page->shm.obj == obj && page->shm.idx == idx) {
+		pml4_clear_page_gather (tlb, page->va); // 여기서 지우면 destroy에서는 할 일이 없음
+		hash_delete (&spt->pages, &page->elem_hash);
+		vm_dealloc_page (page);
+
+		addr += PGSIZE;
+		idx++;
+		page = spt_find_page (spt, addr);
+	}
+}
+
+/* Shared pages never get a private frame, see shm_claim_page(). */
+static bool
+shm_swap_in (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
+}
+
+/* Object frames are not in the frame table, so they are never
+ * chosen for eviction. */
+static bool
+shm_swap_out (struct page *page UNUSED) {
+	return false;
+}
+
+/* Unmaps PAGE and drops its reference to the object.  The mapping
+ * has to go before the page table is destroyed, which would free
+ * the object's frame otherwise. */
+static void
+shm_destroy (struct page *page) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct shm_object *obj = page->shm.obj;
+
+	if (pml4 != NULL && pml4_get_page (pml4, page->va) != NULL)
+		pml4_clear_page (pml4, page->va);
+
+	lock_acquire (&shm_lock);
+	obj->ref_cnt--;
+	shm_release (obj);
+	lock_release (&shm_lock);
+}
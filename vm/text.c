@@ -0,0 +1,280 @@
+/* text.c: Shared page cache for read-only segments of executables.
+ *
+ * 실행 파일의 read-only segment (code, rodata) page는 처음 fault가 났을 때
+ * private frame에 읽어오지 않고 (inode, offset, read_byte) 로 찾는 cache entry의
+ * frame을 read-only로 매핑함 (VM_TEXT). 같은 실행 파일을 실행하는 다른 process는
+ * disk를 읽지 않고 같은 frame을 매핑하므로 code는 한번만 읽히고 한벌만 memory에
+ * 올라감. 실행 중인 파일은 file_deny_write 로 쓰기가 막혀있으므로 cache가 file과
+ * 달라질 일이 없음.
+ *
+ * entry의 frame은 frame table에 들어가지 않으므로 evict 되지 않고, 매핑한 page가
+ * 하나도 남지 않으면 inode와 함께 해제됨. 그래서 cache는 pinned frame 한도의
+ * 절반까지만 커지고, 가득 찬 뒤에 처음 올라오는 page는 cache를 거치지 않고
+ * 평소처럼 evict 될 수 있는 private frame에 읽음. mprotect 로 쓰기가 허용된 page는 첫
+ * 쓰기 때 다시 private page로 돌아감. */
+
+#include "vm/text.h"
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include "vm/vm.h"
+#include "filesys/file.h"
+#include "filesys/inode.h"
+#include "threads/malloc.h"
+#include "threads/mmu.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "userprog/process.h"
+
+static bool text_swap_in (struct page *page, void *kva);
+static bool text_swap_out (struct page *page);
+static void text_destroy (struct page *page);
+
+/* DO NOT MODIFY this struct */
+static const struct page_operations text_ops = {
+	.swap_in = text_swap_in,
+	.swap_out = text_swap_out,
+	.destroy = text_destroy,
+	.type = VM_TEXT,
+};
+
+/* 실행 파일의 page 하나의 내용 */
+struct text_entry {
+	struct inode *inode;     /* 실행 파일, entry가 있는 동안 열어둠 */
+	off_t offset;            /* file 안에서의 위치 */
+	size_t read_byte;        /* file에서 읽은 byte 수, 나머지는 0 */
+	void *kva;               /* 내용을 담은 frame */
+	size_t ref_cnt;          /* 이 entry를 매핑하고 있는 page 수 */
+	struct hash_elem elem;   /* text_entries 의 원소 */
+};
+
+static struct lock text_lock;      /* text_entries 와 entry 정보를 보호함 */
+static struct hash text_entries;   /* (inode, offset, read_byte) 로 찾는 entry */
+
+/* 통계 */
+static size_t stat_cached;         /* 지금 cache에 있는 page 수 */
+static uint64_t stat_hits;         /* disk를 읽지 않고 매핑한 횟수 */
+static uint64_t stat_misses;       /* file에서 읽어서 새로 만든 entry 수 */
+
+/* Hashes a text_entry by its file position. */
+static uint64_t
+text_hash (const struct hash_elem *e, void *aux UNUSED) {
+	const struct text_entry *entry = hash_entry (e, struct text_entry, elem);
+	return hash_bytes (&entry->inode, sizeof entry->inode)
+	       ^ hash_int (entry->offset) ^ hash_int (entry->read_byte);
+}
+
+/* Orders text_entries by inode, offset and read_byte. */
+static bool
+text_less (const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
+	const struct text_entry *a = hash_entry (a_, struct text_entry, elem);
+	const struct text_entry *b = hash_entry (b_, struct text_entry, elem);
+
+	if (a->inode != b->inode)
+		return a->inode < b->inode;
+	if (a->offset != b->offset)
+		return a->offset < b->offset;
+	return a->read_byte < b->read_byte;
+}
+
+/* Initializes the text page cache. */
+void
+text_init (void) {
+	lock_init (&text_lock);
+	hash_init (&text_entries, text_hash, text_less, NULL);
+}
+
+/* Returns true if PAGE is a not yet loaded page of a read-only
+ * executable segment, whose contents can come from the cache. */
+bool
+text_page_eligible (struct page *page) {
+	return page->operations->type == VM_UNINIT && !page->writable
+	       && VM_TYPE (page->uninit.type) == VM_ANON
+	       && page->uninit.init == lazy_load_segment;
+}
+
+/* Returns the entry for READ_BYTE bytes at OFFSET in INODE, or NULL.
+ * Must hold text_lock. */
+static struct text_entry *
+text_lookup (struct inode *inode, off_t offset, size_t read_byte) {
+	struct text_entry key = { .inode = inode, .offset = offset, .read_byte = read_byte };
+	struct hash_elem *e = hash_find (&text_entries, &key.elem);
+
+	return e != NULL ? hash_entry (e, struct text_entry, elem) : NULL;
+}
+
+/* Finds or creates the cache entry for PAGE, a text_page_eligible()
+ * page, and turns PAGE into a VM_TEXT page that refers to it.
+ * Returns false, leaving PAGE as it is, if the page is not cached
+ * and the cache is full or cannot be filled. */
+static bool
+text_attach (struct page *page) {
+	struct container *aux = page->uninit.aux;
+	struct inode *inode = file_get_inode (aux->file);
+	struct text_entry *entry, *fresh = NULL;
+	bool full;
+
+	lock_acquire (&text_lock);
+	entry = text_lookup (inode, aux->offset, aux->read_byte);
+	if (entry != NULL) { // 다른 process가 이미 읽어둔 page
+		entry->ref_cnt++;
+		stat_hits++;
+	}
+	full = stat_cached >= vm_pinned_limit () / 2;
+	lock_release (&text_lock);
+	if (entry == NULL && full)
+		return false;
+
+	if (entry == NULL) { // disk를 읽는 동안 다른 process들을 막지 않도록 lock 밖에서 읽음
+		fresh = malloc (sizeof *fresh);
+		if (fresh == NULL)
+			return false;
+		fresh->kva = vm_get_pinned_page (); // 0으로 채워져 있으니 read_byte 뒤는 채울 필요 없음
+		if (fresh->kva == NULL) {
+			free (fresh);
+			return false;
+		}
+		if (file_read_at (aux->file, fresh->kva, aux->read_byte, aux->offset) != (int) aux->read_byte) {
+			vm_free_pinned_page (fresh->kva);
+			free (fresh);
+			return false;
+		}
+		fresh->inode = inode;
+		fresh->offset = aux->offset;
+		fresh->read_byte = aux->read_byte;
+		fresh->ref_cnt = 0;
+
+		lock_acquire (&text_lock);
+		entry = text_lookup (inode, aux->offset, aux->read_byte); // 읽는 동안 다른 process가 먼저 넣었을 수 있음
+		if (entry == NULL) {
+			entry = fresh;
+			fresh = NULL;
+			inode_reopen (inode); // entry가 있는 동안 inode가 닫혀서 다른 file이 같은 주소를 받지 않게 함
+			hash_insert (&text_entries, &entry->elem);
+			stat_cached++;
+			stat_misses++;
+		} else
+			stat_hits++;
+		entry->ref_cnt++;
+		lock_release (&text_lock);
+
+		if (fresh != NULL) {
+			vm_free_pinned_page (fresh->kva);
+			free (fresh);
+		}
+	}
+
+	page->operations = &text_ops;
+	page->text.entry = entry;
+	page->text.aux = aux;
+	return true;
+}
+
+/* Maps the cached frame of PAGE read-only, loading it into the
+ * cache first if no process has done so yet.  Returns false if PAGE
+ * is still a text_page_eligible() page afterwards, in which case it
+ * can be loaded into a private frame instead. */
+bool
+text_claim_page (struct page *page) {
+	if (page->operations->type != VM_TEXT && !text_attach (page))
+		return false;
+	return pml4_set_page (thread_current ()->pml4, page->va, page->text.entry->kva, false);
+}
+
+/* Adds a page to the current process that maps the same cache entry
+ * as PARENT, a VM_TEXT page of the parent process.  Used by fork. */
+bool
+text_share_page (struct page *parent) {
+	struct container *aux = malloc (sizeof *aux);
+	struct page *page;
+
+	if (aux == NULL)
+		return false;
+	*aux = *parent->text.aux;
+	if (!vm_alloc_page (VM_TEXT, parent->va, parent->writable)) {
+		free (aux);
+		return false;
+	}
+
+	page = spt_find_page (&thread_current ()->spt, parent->va); // 첫 fault 때 text_claim_page 에서 매핑됨
+	page->operations = &text_ops;
+	page->text.entry = parent->text.entry;
+	page->text.aux = aux;
+	page->advice = parent->advice;
+	lock_acquire (&text_lock);
+	page->text.entry->ref_cnt++;
+	lock_release (&text_lock);
+	return true;
+}
+
+/* Unmaps PAGE and drops its reference to the cache entry, freeing
+ * the entry with its last page. */
+static void
+text_release (struct page *page) {
+	uint64_t *pml4 = thread_current ()->pml4;
+	struct text_entry *entry = page->text.entry;
+
+	if (pml4 != NULL && pml4_get_page (pml4, page->va) != NULL) // pml4_destroy 가 cache의 frame을 free 하지 않도록 매핑을 먼저 풀어줌
+		pml4_clear_page (pml4, page->va);
+
+	lock_acquire (&text_lock);
+	if (--entry->ref_cnt == 0) {
+		hash_delete (&text_entries, &entry->elem);
+		stat_cached--;
+		vm_free_pinned_page (entry->kva);
+		inode_close (entry->inode);
+		free (entry);
+	}
+	lock_release (&text_lock);
+}
+
+/* Turns PAGE, a VM_TEXT page that was made writable, back into a
+ * private lazily loaded page of its file, so that the following
+ * write does not change the shared copy. */
+bool
+text_unshare_page (struct page *page) {
+	struct container *aux = page->text.aux;
+	struct hash_elem elem = page->elem_hash;
+	bool writable = page->writable;
+	uint8_t advice = page->advice;
+
+	text_release (page);
+	uninit_new (page, page->va, lazy_load_segment, VM_ANON, aux, anon_initializer);
+	page->elem_hash = elem; // uninit_new 이 page 전체를 덮어쓰니 spt 정보는 되살려줌
+	page->writable = writable;
+	page->zero_mapped = false;
+	page->advice = advice;
+	return true;
+}
+
+/* Text pages never get a private frame, see text_claim_page(). */
+static bool
+text_swap_in (struct page *page UNUSED, void *kva UNUSED) {
+	return false;
+}
+
+/* Cache frames are not in the frame table, so they are never
+ * chosen for eviction. */
+static bool
+text_swap_out (struct page *page UNUSED) {
+	return false;
+}
+
+/* Unmaps PAGE and drops its reference to the cache entry. */
+static void
+text_destroy (struct page *page) {
+	text_release (page);
+	free (page->text.aux);
+}
+
+/* Prints text page cache statistics. */
+void
+text_print_stats (void) {
+	if (stat_misses == 0)
+		return;
+
+	printf ("Text cache: %zu pages cached, %"PRIu64" hits, %"PRIu64" misses\n",
+	        stat_cached, stat_hits, stat_misses);
+}
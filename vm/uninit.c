@@ -66,6 +66,8 @@ uninit_destroy (struct page *page) {
 	struct uninit_page *uninit UNUSED = &page->uninit;
 	/* TODO: Fill this function.
 	 * TODO: If you don't have anything to do, just return. */
+
+	vm_unmap_zero_page (page); // 공용 zero frame이 pml4_destroy 에서 free 되지 않도록 매핑을 풀어줌
 	
 	// free(uninit->aux);
 	// struct container *contain = (struct container*)uninit->aux;
@@ -1,12 +1,17 @@
 /* vm.c: Generic interface for virtual memory objects. */
 
+#include <string.h>
 #include "threads/malloc.h"
 #include "vm/vm.h"
 #include "vm/inspect.h"
+#include "vm/ksm.h"
 #include "userprog/process.h"
 #include "userprog/syscall.h"
 #include "filesys/file.h"
 #include "threads/vaddr.h"
+#include "threads/mmu.h"
+#include "devices/timer.h"
+#include "intrinsic.h"
 
 /* Initializes the virtual memory subsystem by invoking each subsystem's
  * intialize codes. */
@@ -14,6 +19,58 @@
 struct list frame_table;
 struct list_elem *start;
 
+/* frame_table, ready_frames 와 frame의 owner, resident 개수를 보호함 */
+struct lock frame_lock;
+static struct condition writeback_done; // frame의 writeback 표시가 지워질 때마다 알림
+
+/* kswapd 가 미리 비워서 0으로 채워둔 frame들 */
+static struct list ready_frames;
+static size_t ready_cnt;
+
+/* Free frame watermarks for kswapd (kernel command line -kswapd=N).
+ * kswapd wakes up below vm_free_high / 4 free frames and evicts until
+ * vm_free_high frames are free; 0 disables it. */
+size_t vm_free_high = 32;
+static struct semaphore kswapd_sema; // kswapd를 깨울 때 up 함
+static bool kswapd_active;           // kswapd가 이미 깨어나서 일하는 중인지
+static uint64_t kswapd_reclaimed;    // kswapd가 미리 비운 frame 수
+
+static void kswapd (void *aux);
+
+/* Fault-around and swap read-ahead tuning.
+ * 커널 command line의 "-fa=N", "-ra=N" 으로 바꿀 수 있음. */
+size_t vm_fault_around = 4;   // fault 한번에 같은 file 영역에서 추가로 채워넣을 page 수
+size_t vm_readahead_max = 8;  // 순차적인 swap-in 일 때 read-ahead window의 최댓값
+
+/* 2 MiB 로 정렬된 영역 전체가 아직 한번도 올라오지 않은 같은 종류의 page들로 채워져
+ * 있으면 page directory entry 하나로 매핑함 ("-hp=0" 으로 끔). */
+size_t vm_huge_pages = 1;
+
+/* Working set 을 다시 sampling 하는 주기 (tick) */
+#define VM_WS_INTERVAL TIMER_FREQ
+
+/* Fault latency histogram: bucket i counts faults that took
+ * [2^i, 2^(i+1)) cycles, the last bucket everything above. */
+#define FAULT_HIST_BUCKETS 32
+bool vm_fault_report;         // "-fstat" 이면 process 가 끝날 때 fault 통계를 출력함
+static uint64_t fault_hist[VM_FAULT_CLASS_CNT][FAULT_HIST_BUCKETS];
+static uint64_t fault_total_cnt[VM_FAULT_CLASS_CNT];
+static uint64_t fault_total_cycles[VM_FAULT_CLASS_CNT];
+static const char *fault_class_names[VM_FAULT_CLASS_CNT] = {
+  "minor", "file", "swap", "stack", "cow",
+};
+
+static size_t vm_huge_mapped; // huge page로 매핑한 횟수
+
+/* vm_get_pinned_page() 로 나간 frame은 evict 되지 않으므로 user pool의 일부만 줄 수 있음 */
+static size_t pinned_cnt;     // 지금 나가있는 pinned frame 수, frame_lock 으로 보호함
+static size_t pinned_max;     // pinned frame의 최대 개수 (user pool의 절반)
+
+/* 모든 process가 같이 쓰는 read-only zero frame.
+ * 아직 한번도 쓰여진 적 없는 anonymous page를 읽기만 하면 이 frame을 매핑해주고
+ * 처음으로 쓰기가 일어날 때 private frame을 할당함. */
+static void *zero_kva;
+
 void
 vm_init (void) {
   vm_anon_init ();
@@ -24,8 +81,20 @@ vm_init (void) {
   register_inspect_intr ();
 
   list_init (&frame_table);
+  zero_kva = palloc_get_page (PAL_ASSERT | PAL_ZERO); // 공용 zero frame은 kernel pool에서 받아둠
   /* DO NOT MODIFY UPPER LINES. */
   /* TODO: Your code goes here. */
+  shm_init ();
+  text_init ();
+  lock_init (&frame_lock);
+  cond_init (&writeback_done);
+  pinned_max = palloc_free_cnt (PAL_USER) / 2; // 나머지 절반은 항상 evict 해서 돌려쓸 수 있음
+  ksm_init ();
+  list_init (&ready_frames);
+  sema_init (&kswapd_sema, 0);
+  if (vm_free_high > 0)
+    thread_create ("kswapd", PRI_MIN, kswapd, NULL);
+  file_writeback_init ();
 }
 
 /* Get the type of the page. This function is useful if you want to know the
@@ -45,7 +114,15 @@ page_get_type (struct page *page) {
 /* Helpers */
 static struct frame *vm_get_victim (void);
 static bool vm_do_claim_page (struct page *page);
+static bool vm_map_frame (struct page *page, struct frame *frame);
 static struct frame *vm_evict_frame (void);
+static struct frame *vm_get_free_frame (void);
+static void vm_fault_around_pages (struct supplemental_page_table *spt, struct page *page, struct container *region);
+static void vm_swap_readahead (struct supplemental_page_table *spt, struct page *page);
+static bool page_zero_fill (struct page *page);
+static bool vm_map_zero_page (struct page *page);
+static bool vm_claim_huge_page (struct supplemental_page_table *spt, struct page *page);
+static bool vm_unmerge_page (struct page *page);
 
 /* Create the pending page object with initializer. If you want to create a
  * page, do not create it directly and make it through this function or
@@ -74,6 +151,9 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, v
     case VM_FILE:
       initializer_vm = file_backed_initializer;
       break;
+    case VM_SHM: // shm page는 만들어지자마자 shm_add_page 에서 바로 초기화됨
+    case VM_TEXT: // text page도 text_share_page 에서 바로 초기화됨
+      break;
     default:
       PANIC ("vm initial fail");
       break;
@@ -82,6 +162,8 @@ vm_alloc_page_with_initializer (enum vm_type type, void *upage, bool writable, v
     uninit_new (page, upage, init, type, aux, initializer_vm);  // 그 이후 uninit_new 를 사용하여 uninit 페이지 구조를 생성함
 
     page->writable = writable; // 할당받은 page의 writable에 input 된 writable 정보를 넣어줌
+    page->zero_mapped = false;
+    page->advice = VM_ADV_NORMAL;
 
     /* TODO: Insert the page into the spt. */
     return spt_insert_page (spt, page); // 새로만들어진 page를 spt 에 insert를 해줌
@@ -118,23 +200,52 @@ spt_insert_page (struct supplemental_page_table *spt UNUSED,
 
 void
 spt_remove_page (struct supplemental_page_table *spt, struct page *page) {
+  delete_page (&spt->pages, page);
   vm_dealloc_page (page);
-  return true;
 }
 
-/* Get the struct frame, that will be evicted. */
+/* Returns the thread whose address space SPT describes. */
+static struct thread *
+spt_thread (struct supplemental_page_table *spt) {
+  return (struct thread *) ((uint8_t *) spt - offsetof (struct thread, spt));
+}
+
+/* Returns the page table that maps the page held by FRAME: the one
+ * of the process it is charged to. */
+static uint64_t *
+frame_pml4 (struct frame *frame) {
+  if (frame->owner == NULL)
+    return thread_current ()->pml4;
+  return spt_thread (frame->owner)->pml4;
+}
+
+/* Returns the page table that PAGE is mapped in.  Eviction may run
+ * on behalf of another process or in kswapd, so swap_out must not
+ * assume the current thread owns the page. */
+uint64_t *
+page_pml4 (struct page *page) {
+  if (page->frame == NULL)
+    return thread_current ()->pml4;
+  return frame_pml4 (page->frame);
+}
+
+/* Get the struct frame, that will be evicted.
+ * Must hold frame_lock. */
 static struct frame *
 vm_get_victim (void) {
   struct frame *victim = NULL;
   /* TODO: The policy for eviction is up to you. */
 
-  struct thread *cur = thread_current (); // 현재 thread를 불러오고
   struct list_elem *s; // list 순회를 위해서 필요한 list_elem 선언
 
   for (s = list_begin (&frame_table); s != list_end (&frame_table); s = list_next (s)) { // frame은 전역변수로 선언이 되어있음
-    victim = list_entry (s, struct frame, elem_fr); // frame으로 확장
-    if (pml4_is_accessed (cur->pml4, victim->page->va)) // PML4에 VPAGE용 PTE가 있는지 없는지 확인함 -> 즉 pml4에 해당 page가 있는지 없는지 찾는 부분 --> 있으면 true, 없으면 false
-      pml4_set_accessed (cur->pml4, victim->page->va, 0); // 만일 있었다면 해당 access를 0으로 바꿔줌
+    struct frame *frame = list_entry (s, struct frame, elem_fr); // frame으로 확장
+    if (frame->writeback) // file에 쓰고 있는 중인 frame은 건너뜀
+      continue;
+    victim = frame;
+    uint64_t *pml4 = frame_pml4 (victim); // 다른 process의 page일 수도 있으니 그 page가 매핑된 pml4를 봐야함
+    if (pml4_is_accessed (pml4, victim->page->va)) // PML4에 VPAGE용 PTE가 있는지 없는지 확인함 -> 즉 pml4에 해당 page가 있는지 없는지 찾는 부분 --> 있으면 true, 없으면 false
+      pml4_set_accessed (pml4, victim->page->va, 0); // 만일 있었다면 해당 access를 0으로 바꿔줌
     else
       return victim; 
   }
@@ -142,82 +253,488 @@ vm_get_victim (void) {
   return victim;
 }
 
+/* Charges FRAME to the resident set of SPT.  Must hold frame_lock. */
+static void
+frame_charge (struct frame *frame, struct supplemental_page_table *spt) {
+  frame->owner = spt;
+  if (++spt->resident_cnt > spt->resident_peak)
+    spt->resident_peak = spt->resident_cnt;
+}
+
+/* Removes FRAME from the resident set of its owner, if any.  Must
+ * hold frame_lock. */
+static void
+frame_uncharge (struct frame *frame) {
+  if (frame->owner != NULL) {
+    frame->owner->resident_cnt--;
+    frame->owner = NULL;
+  }
+}
+
+/* Clears the writeback mark of FRAME and wakes up the threads
+ * waiting in vm_frame_settle().  Must hold frame_lock. */
+void
+vm_writeback_end (struct frame *frame) {
+  frame->writeback = false;
+  cond_broadcast (&writeback_done, &frame_lock);
+}
+
+/* Waits until the frame of PAGE, if any, is no longer being evicted
+ * or written back, so that page->frame stays put while frame_lock is
+ * held.  Must hold frame_lock. */
+static void
+vm_frame_settle (struct page *page) {
+  while (page->frame != NULL && page->frame->writeback)
+    cond_wait (&writeback_done, &frame_lock);
+}
+
+/* Swaps out the page held by VICTIM and takes the frame out of the
+ * frame table so it can be reused.  Returns NULL, leaving the page
+ * in place at the end of the frame table, if it cannot be swapped
+ * out because swap space is full.  Must hold frame_lock, which is
+ * released during the swap-out itself; VICTIM is marked writeback
+ * meanwhile, so it is neither chosen again nor freed. */
+static struct frame *
+vm_evict (struct frame *victim) {
+  bool success;
+
+  victim->writeback = true;
+  lock_release (&frame_lock); // 압축이나 disk 쓰기 동안 다른 fault와 frame 할당을 막지 않음
+  success = swap_out (victim->page); // 제거될 frame을 disk에 복사함 -- 실패하면 내용이 그대로 남아있어야 함
+  lock_acquire (&frame_lock);
+  vm_writeback_end (victim);
+  if (!success) {
+    list_remove (&victim->elem_fr); // 바로 다시 골라지지 않도록 뒤로 보냄
+    list_push_back (&frame_table, &victim->elem_fr);
+    return NULL;
+  }
+  victim->page->frame = NULL; // 쫓겨난 page는 더 이상 이 frame을 가리키지 않음
+  victim->page = NULL;
+  vm_frame_detach (victim);
+  victim->zeroed = false;
+  return victim;
+}
+
 /* Evict one page and return the corresponding frame.
- * Return NULL on error.*/
+ * Return NULL on error.  Must hold frame_lock. */
 static struct frame *
 vm_evict_frame (void) {
-  struct frame *victim = vm_get_victim (); // vm_get_victim() --> 제거될 frame을 가져옴
-  /* TODO: swap out the victim and return the evicted frame. */
-  swap_out (victim->page); // 제거될 frame을 disk에 복사함
+  size_t tries = list_size (&frame_table);
+  struct frame *frame = NULL;
+
+  while (frame == NULL && tries-- > 0) { // 내보내지 못한 page가 있으면 다른 victim 을 고름
+    struct frame *victim = vm_get_victim (); // vm_get_victim() --> 제거될 frame을 가져옴
+    /* TODO: swap out the victim and return the evicted frame. */
+    if (victim == NULL)
+      return NULL;
+    frame = vm_evict (victim);
+  }
+  return frame; // 제거될 frame을 return 함
+}
+
+/* Evicts one of SPT's own pages, picked with the same second chance
+ * scan as vm_get_victim() but restricted to frames charged to SPT.
+ * Used when the process is at its resident limit.  Returns NULL if
+ * SPT has no evictable frame.  Must hold frame_lock. */
+static struct frame *
+vm_evict_own_frame (struct supplemental_page_table *spt) {
+  uint64_t *pml4 = thread_current ()->pml4;
+  struct frame *victim = NULL;
+  struct list_elem *e;
+
+  for (int pass = 0; pass < 2 && victim == NULL; pass++) // 모든 page가 접근된 상태여도 두번째 바퀴에서는 고를 수 있음
+    for (e = list_begin (&frame_table); e != list_end (&frame_table); e = list_next (e)) {
+      struct frame *frame = list_entry (e, struct frame, elem_fr);
+      if (frame->owner != spt || frame->writeback)
+        continue;
+      if (pml4_is_accessed (pml4, frame->page->va))
+        pml4_set_accessed (pml4, frame->page->va, false);
+      else {
+        victim = frame;
+        break;
+      }
+    }
+  if (victim == NULL || (victim = vm_evict (victim)) == NULL)
+    return NULL;
 
-  return victim; // 제거될 frame을 return 함
+  spt->self_evict_cnt++;
+  return victim;
+}
+
+/* Returns the number of user frames that can be handed out without
+ * evicting anything. */
+static size_t
+vm_free_frames (void) {
+  return palloc_free_cnt (PAL_USER) + ready_cnt;
+}
+
+/* Takes a frame that needs no eviction: a pre-zeroed one from
+ * kswapd first, otherwise a fresh user pool page.  Returns NULL if
+ * neither is left.  Must hold frame_lock. */
+static struct frame *
+vm_take_free_frame (void) {
+  struct frame *frame;
+
+  if (!list_empty (&ready_frames)) { // kswapd가 미리 비워서 0으로 채워둔 frame
+    ready_cnt--;
+    return list_entry (list_pop_front (&ready_frames), struct frame, elem_fr);
+  }
+
+  void *kva = palloc_get_page (PAL_USER); // frame의 물리메모리 주소에 PAL_USER로 page를 할당 받아서 넣는다 -- Gitbook 에 PAL_USER로 할당 받아야한다는게 있음
+  if (kva == NULL)
+    return NULL;
+  frame = (struct frame *) malloc (sizeof (struct frame)); // frame 공간을 할당 받고
+  if (frame == NULL) {
+    palloc_free_page (kva);
+    return NULL;
+  }
+  frame->kva = kva;
+  frame->zeroed = false;
+  frame->writeback = false;
+  frame->ksm_unstable = false;
+  return frame;
+}
+
+/* Wakes kswapd if free frames dropped below the low watermark. */
+static void
+kswapd_wakeup (void) {
+  if (vm_free_high == 0 || kswapd_active || vm_free_frames () >= vm_free_high / 4)
+    return;
+  kswapd_active = true;
+  sema_up (&kswapd_sema);
 }
 
 /* palloc() and get frame. If there is no available page, evict the page
- * and return it. This always return valid address. That is, if the user pool
- * memory is full, this function evicts the frame to get the available memory
- * space.*/
+ * and return it. That is, if the user pool memory is full, this function
+ * evicts the frame to get the available memory space.  Returns NULL if
+ * nothing can be evicted either, because every user frame is pinned or
+ * still being loaded; the faulting process is then killed. */
 //모든 유저 공간 페이지들은 이 함수를 통해서 할당될 것임
+// 돌려준 frame은 vm_map_frame 에서 내용이 다 올라온 다음에야 frame table에 들어감 (올라오는 도중에 evict 되지 않도록)
 static struct frame *
 vm_get_frame (void) { // palloc으로 page를 얻고 frame을 가져옴
-  struct frame *frame = (struct frame *) malloc (sizeof (struct frame)); // frame 공간을 할당 받고
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  struct frame *frame = NULL;
   /* TODO: Fill this function. */
 
-  frame->kva = palloc_get_page (PAL_USER); // frame의 물리메모리 주소에 PAL_USER로 page를 할당 받아서 넣는다 -- Gitbook 에 PAL_USER로 할당 받아야한다는게 있음
-  if (frame->kva == NULL) { // 만약 할당에 실패했다면
+  lock_acquire (&frame_lock);
+  if (spt->rss_limit != 0 && spt->resident_cnt >= spt->rss_limit) // 제한에 걸렸으면 다른 process 대신 자기 page를 내보냄
+    frame = vm_evict_own_frame (spt);
+  if (frame == NULL)
+    frame = vm_take_free_frame ();
+  if (frame == NULL) // 만약 할당에 실패했다면
     frame = vm_evict_frame (); // 제거될 frame을 return 받아서 frame에 저장해줌
-    frame->page = NULL; // page는 NULL로 하고
-    return frame; // 그 frame을 반환함
-  }
-  list_push_back (&frame_table, &frame->elem_fr); // 위 if문에 걸리지 않았다면 frame table에 현재 frame을 넣어주고
-  frame->page = NULL; // page는 NULL로 함 -- frame 내의 page에는 아직 할당된게 없으니깐
+  lock_release (&frame_lock);
+  kswapd_wakeup (); // 여유 frame이 적어졌으면 kswapd가 미리 비워두게 함
 
-  ASSERT (frame != NULL);
-  ASSERT (frame->page == NULL);
+  if (frame == NULL) // 내보낼 수 있는 page도 없음
+    return NULL;
+  frame->page = NULL; // page는 NULL로 함 -- frame 내의 page에는 아직 할당된게 없으니깐
+  frame->owner = NULL;
 
   return frame; // 해당 frame을 return 함
 }
 
+/* Returns a zeroed user pool page that is not tracked in the frame
+ * table, evicting another page if the pool is exhausted.  The page
+ * can never be chosen for eviction itself; used for the frames of
+ * shared memory objects and of the text cache.  Returns NULL once
+ * half of the user pool is pinned, so that the other half can
+ * always be reclaimed.  Free the page with vm_free_pinned_page(). */
+void *
+vm_get_pinned_page (void) {
+  struct frame *frame;
+  void *kva;
+
+  lock_acquire (&frame_lock);
+  if (pinned_cnt >= pinned_max) {
+    lock_release (&frame_lock);
+    return NULL;
+  }
+  pinned_cnt++;
+  lock_release (&frame_lock);
+
+  frame = vm_get_frame ();
+  if (frame == NULL) {
+    vm_free_pinned_page (NULL);
+    return NULL;
+  }
+  kva = frame->kva;
+  if (!frame->zeroed)
+    memset (kva, 0, PGSIZE);
+  free (frame); // frame table에 넣지 않으니 evict 대상이 되지 않음
+  return kva;
+}
+
+/* Frees KVA, a page obtained with vm_get_pinned_page(). */
+void
+vm_free_pinned_page (void *kva) {
+  palloc_free_page (kva);
+  lock_acquire (&frame_lock);
+  pinned_cnt--;
+  lock_release (&frame_lock);
+}
+
+/* Returns the largest number of pages vm_get_pinned_page() hands
+ * out at once. */
+size_t
+vm_pinned_limit (void) {
+  return pinned_max;
+}
+
+/* palloc() and get frame only if a free user page is available right now.
+ * Unlike vm_get_frame(), this never evicts; it returns NULL instead.
+ * Used for speculative work such as fault-around and read-ahead. */
+static struct frame *
+vm_get_free_frame (void) {
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  struct frame *frame;
+
+  if (spt->rss_limit != 0 && spt->resident_cnt >= spt->rss_limit) // 제한에 걸린 process는 미리 읽지 않음
+    return NULL;
+
+  lock_acquire (&frame_lock);
+  frame = vm_take_free_frame (); // 여유 frame이 없으면 다른 page를 쫓아내면서까지 미리 읽어오지 않음
+  lock_release (&frame_lock);
+  if (frame == NULL)
+    return NULL;
+  kswapd_wakeup ();
+
+  frame->page = NULL;
+  frame->owner = NULL;
+  return frame;
+}
+
+/* Background reclaim thread.  Sleeps until the number of free
+ * frames drops below the low watermark (vm_free_high / 4), then
+ * evicts pages until vm_free_high frames are free again.  Reclaimed
+ * frames are zeroed here, off the fault path, and kept on
+ * ready_frames for the next allocations.  Runs at the lowest
+ * priority so it only uses otherwise idle CPU time. */
+static void
+kswapd (void *aux UNUSED) {
+  for (;;) {
+    sema_down (&kswapd_sema);
+    while (vm_free_frames () < vm_free_high) {
+      lock_acquire (&frame_lock);
+      struct frame *frame = vm_evict_frame ();
+      lock_release (&frame_lock);
+      if (frame == NULL) // 더 내보낼 page가 없음
+        break;
+
+      memset (frame->kva, 0, PGSIZE); // fault 처리 중이 아닐 때 미리 0으로 채워둠
+      frame->zeroed = true;
+      lock_acquire (&frame_lock);
+      list_push_back (&ready_frames, &frame->elem_fr);
+      ready_cnt++;
+      kswapd_reclaimed++;
+      lock_release (&frame_lock);
+    }
+    kswapd_active = false;
+  }
+}
+
 /* Growing the stack. */
 static void
-vm_stack_growth (void *addr UNUSED) {
+vm_stack_growth (void *addr UNUSED, bool write) {
   if (vm_alloc_page (VM_ANON | VM_MARKER_0, addr, 1)) { // 해당 addr를 이용하여 page를 할당 받고 거기서 성공했다면
-    vm_claim_page (addr); // claim_page를 통해서 연결해주고
+    if (write)
+      vm_claim_page (addr); // claim_page를 통해서 연결해주고
+    else
+      vm_map_zero_page (spt_find_page (&thread_current ()->spt, addr)); // 읽기만 했다면 아직 frame을 줄 필요가 없음
     thread_current ()->stack_bottom -= PGSIZE; // PGSIZE 만큼 늘었으니 stack_bottom을 PGSIZE 만큼 늘려줌
   }
 }
 
 /* Handle the fault on write_protected page */
 static bool
-vm_handle_wp (struct page *page UNUSED) {}
+vm_handle_wp (struct page *page UNUSED) {
+  if (!page->writable) // 원래 쓰기가 안되는 page면 진짜 잘못된 접근임
+    return false;
 
-/* Return true on success */
-bool
-vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED, bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
-  struct supplemental_page_table *spt UNUSED = &thread_current ()->spt;
+  if (page->zero_mapped) { // 공용 zero frame에 처음으로 쓰기가 일어났다면
+    pml4_clear_page (thread_current ()->pml4, page->va);
+    page->zero_mapped = false;
+    return vm_do_claim_page (page); // 이제서야 private frame을 받아서 0으로 채움
+  }
+  if (ksm_page_kva (page) != NULL) // ksm으로 합쳐진 page라면 내용을 복사해서 떼어냄
+    return vm_unmerge_page (page);
+  if (page->operations->type == VM_TEXT) // mprotect 로 쓰기가 허용된 code page는 file에서 private frame으로 다시 읽음
+    return text_unshare_page (page) && vm_do_claim_page (page);
+  return false;
+}
+
+/* Gives PAGE, which maps a frame shared by same-page merging, a
+ * private writable copy of that frame. */
+static bool
+vm_unmerge_page (struct page *page) {
+  struct frame *frame = vm_get_frame ();
+
+  if (frame == NULL)
+    return false;
+  memcpy (frame->kva, ksm_page_kva (page), PGSIZE); // page가 참조하는 동안은 공유 frame이 사라지지 않음
+  pml4_clear_page (thread_current ()->pml4, page->va);
+  ksm_unmerge (page);
+
+  frame->page = page;
+  page->frame = frame;
+  if (!install_page (page->va, frame->kva, page->writable)) {
+    page->frame = NULL;
+    palloc_free_page (frame->kva);
+    free (frame);
+    return false;
+  }
+  frame->zeroed = false;
+  lock_acquire (&frame_lock);
+  frame_charge (frame, &thread_current ()->spt);
+  list_push_back (&frame_table, &frame->elem_fr);
+  lock_release (&frame_lock);
+  return true;
+}
+
+/* Returns true if PAGE would be filled with nothing but zeros when
+ * it is first claimed: an untouched anonymous page without file
+ * contents (stack growth, BSS). */
+static bool
+page_zero_fill (struct page *page) {
+  if (page->frame != NULL || page->zero_mapped || page->operations->type != VM_UNINIT
+      || VM_TYPE (page->uninit.type) != VM_ANON)
+    return false;
+  if (page->uninit.init == NULL)
+    return true;
+  return page->uninit.init == lazy_load_segment
+         && ((struct container *) page->uninit.aux)->read_byte == 0;
+}
+
+/* Maps the shared zero frame read-only at PAGE's address.  PAGE
+ * stays uninitialized until the first write. */
+static bool
+vm_map_zero_page (struct page *page) {
+  if (page == NULL || !pml4_set_page (thread_current ()->pml4, page->va, zero_kva, false))
+    return false;
+  page->zero_mapped = true;
+  return true;
+}
+
+/* Removes the shared zero frame mapping of PAGE, if any.  Must be
+ * called before the page table is destroyed, which would otherwise
+ * free the shared frame. */
+void
+vm_unmap_zero_page (struct page *page) {
+  if (page->zero_mapped) {
+    pml4_clear_page (thread_current ()->pml4, page->va);
+    page->zero_mapped = false;
+  }
+}
+
+/* Records a fault of CLASS that took CYCLES in the global histogram
+ * and in the counters of SPT. */
+static void
+vm_fault_account (struct supplemental_page_table *spt, enum vm_fault_class class,
+                  uint64_t cycles) {
+  int bucket = 0;
+
+  while (bucket < FAULT_HIST_BUCKETS - 1 && (cycles >> (bucket + 1)) != 0)
+    bucket++;
+
+  enum intr_level old_level = intr_disable (); // 전역 통계는 여러 process가 같이 올림
+  fault_hist[class][bucket]++;
+  fault_total_cnt[class]++;
+  fault_total_cycles[class] += cycles;
+  intr_set_level (old_level);
+
+  spt->fault_cnt[class]++;
+  spt->fault_cycles[class] += cycles;
+}
+
+/* Serves the page fault at ADDR; see vm_try_handle_fault().  Stores
+ * the kind of work that was needed in *CLASS. */
+static bool
+vm_handle_fault (struct intr_frame *f, void *addr, bool write, bool not_present,
+                 enum vm_fault_class *class) {
+  struct supplemental_page_table *spt = &thread_current ()->spt;
   struct page *page = NULL;
   /* TODO: Validate the fault */
   /* TODO: Your code goes here */
   if (is_kernel_vaddr (addr)) // addr 를 먼저 check 해줌
     return false;
 
+  if (timer_elapsed (spt->ws_stamp) >= VM_WS_INTERVAL) // 일정 시간마다 working set 크기를 다시 잼
+    vm_ws_sample (spt);
+
   void *rsp_stack = is_kernel_vaddr (f->rsp) ? thread_current ()->rsp_stack : f->rsp; // f->rsp가 kernel address인지 확인하고 kernel이면 thread에 저장한걸 불러오고 user면 frame에 있는걸 그대로 사용
   if (not_present) {
-    if (!vm_claim_page (addr)) {
+    page = spt_find_page (spt, addr);
+    if (page == NULL) {
       if (rsp_stack - 8 <= addr && USER_STACK - 0x100000 <= addr && addr <= USER_STACK) {
         // rsp_stack - 8 --> 다음줄로 옮긴후 그 주소가 addr보다 작으면
         // USER STACK 부터 1MB(GITBOOK에서 허용한 USER_STACK) 까지 이내에 addr가 존재하면
-        vm_stack_growth (thread_current ()->stack_bottom - PGSIZE); // stack을 더 키워줌
+        vm_stack_growth (thread_current ()->stack_bottom - PGSIZE, write); // stack을 더 키워줌
+        *class = VM_FAULT_STACK;
         return true;
       }
       return false;
-    } else
+    }
+
+    lock_acquire (&frame_lock); // 다른 thread가 이 page를 내보내는 중이면 끝날 때까지 기다림
+    vm_frame_settle (page);
+    bool resident = page->frame != NULL;
+    lock_release (&frame_lock);
+    if (resident) // 내보내지 못해서 다시 매핑되었음
+      return true;
+
+    // claim 하고 나면 uninit 정보가 덮어써지니깐 그 전에 어떤 page였는지 기억해둠
+    struct container *region = page_file_region (page);
+    bool swapped = page_in_swap (page);
+    *class = swapped ? VM_FAULT_SWAP : region != NULL ? VM_FAULT_FILE : VM_FAULT_MINOR;
+
+    if (!write && page_zero_fill (page)) // 0으로만 채워질 page를 읽기만 한다면 공용 zero frame을 매핑
+      return vm_map_zero_page (page);
+
+    if (vm_claim_huge_page (spt, page)) // 2MB 영역을 통째로 올릴 수 있으면 huge page로 매핑 -- 읽기만 하는 빈 영역은 위에서 zero frame으로 끝남
       return true;
+
+    if (!vm_do_claim_page (page))
+      return false;
+
+    if (swapped)
+      vm_swap_readahead (spt, page); // swap에서 올라온 page면 순차 접근인지 보고 다음 page들도 미리 올림
+    else if (region != NULL)
+      vm_fault_around_pages (spt, page, region); // file에서 읽어오는 page면 같은 영역의 다음 page들도 같이 읽음
+    return true;
   }
 
+  // page가 있는데 fault가 났다면 read-only page에 쓰기를 시도한 경우
+  page = spt_find_page (spt, addr);
+  *class = VM_FAULT_COW;
+  if (page != NULL && write)
+    return vm_handle_wp (page);
+
   return false;
 }
 
+/* Return true on success */
+bool
+vm_try_handle_fault (struct intr_frame *f UNUSED, void *addr UNUSED, bool user UNUSED, bool write UNUSED, bool not_present UNUSED) {
+  uint64_t start = rdtsc ();
+  enum vm_fault_class class = VM_FAULT_MINOR;
+
+  if (!vm_handle_fault (f, addr, write, not_present, &class))
+    return false;
+  vm_fault_account (&thread_current ()->spt, class, rdtsc () - start);
+  return true;
+}
+
+/* Prints the page fault counters of SPT, the address space of the
+ * process called NAME. */
+void
+vm_print_fault_stats (const struct supplemental_page_table *spt, const char *name) {
+  for (int c = 0; c < VM_FAULT_CLASS_CNT; c++)
+    if (spt->fault_cnt[c] > 0)
+      printf ("%s: %s faults %llu, avg %llu cycles\n", name, fault_class_names[c],
+              spt->fault_cnt[c], spt->fault_cycles[c] / spt->fault_cnt[c]);
+}
+
 /* Free the page.
  * DO NOT MODIFY THIS FUNCTION. */
 void
@@ -244,7 +761,31 @@ vm_claim_page (void *va UNUSED) {
 /* Claim the PAGE and set up the mmu. */
 static bool
 vm_do_claim_page (struct page *page) {
+  if (page->operations->type == VM_SHM) // 공유 page는 private frame 대신 shm 객체의 frame을 매핑함
+    return shm_claim_page (page);
+  if (page->operations->type == VM_TEXT || text_page_eligible (page)) { // 실행 파일의 read-only page는 text cache의 frame을 매핑함
+    if (text_claim_page (page))
+      return true;
+    if (page->operations->type == VM_TEXT)
+      return false;
+    // cache가 가득 찼으면 평소처럼 private frame에 읽음
+  }
+
   struct frame *frame = vm_get_frame ();
+  if (frame != NULL && page->frame != NULL) { // 내보내던 도중에 fault가 났는데 swap 공간이 없어 다시 매핑되었음
+    palloc_free_page (frame->kva);
+    free (frame);
+    return true;
+  }
+  return vm_map_frame (page, frame);
+}
+
+/* Link PAGE with FRAME, map it in the page table and load its
+ * contents. */
+static bool
+vm_map_frame (struct page *page, struct frame *frame) {
+  if (frame == NULL) // vm_get_frame 이 frame을 구하지 못했음
+    return false;
 
   /* Set links */
   frame->page = page; // frame과 page를 이어줌
@@ -252,16 +793,392 @@ vm_do_claim_page (struct page *page) {
 
   /* TODO: Insert page table entry to map page's VA to frame's PA. */
 
-  if (install_page (page->va, frame->kva, page->writable)) // page의 가상메모리와 frame의 물리메모리를 매핑해주고 page의 writable 정보도 같이 써줌
-    return swap_in (page, frame->kva); // 해당 매핑이 성공한다면 해당 페이지를 물리메모리로 swap in 해줌
+  if (install_page (page->va, frame->kva, page->writable)) { // page의 가상메모리와 frame의 물리메모리를 매핑해주고 page의 writable 정보도 같이 써줌
+    if (swap_in (page, frame->kva)) { // 해당 매핑이 성공한다면 해당 페이지를 물리메모리로 swap in 해줌
+      frame->zeroed = false;
+      lock_acquire (&frame_lock); // 내용이 다 올라온 다음에야 evict 대상이 됨
+      frame_charge (frame, &thread_current ()->spt);
+      list_push_back (&frame_table, &frame->elem_fr);
+      lock_release (&frame_lock);
+      return true;
+    }
+    pml4_clear_page (thread_current ()->pml4, page->va);
+  }
+
+  page->frame = NULL; // 실패했다면 frame을 돌려주고 false를 return 함
+  palloc_free_page (frame->kva);
+  free (frame);
+  return false;
+}
+
+/* Returns true if PAGE can be part of a fresh huge page whose first
+ * faulting page is FIRST: a never loaded, not zero-mapped anonymous
+ * page of the same writability.  File pages are left out since a
+ * huge PDE has one dirty bit for all of its pages, and writeback
+ * needs it per page. */
+static bool
+page_huge_eligible (struct page *page, struct page *first) {
+  return page != NULL && page->frame == NULL && !page->zero_mapped
+         && page->operations->type == VM_UNINIT
+         && VM_TYPE (page->uninit.type) == VM_ANON && !text_page_eligible (page)
+         && VM_TYPE (page->uninit.type) == VM_TYPE (first->uninit.type)
+         && page->writable == first->writable;
+}
+
+/* Tries to serve the fault on PAGE by loading the whole 2 MiB aligned
+ * region around it into one physically contiguous, aligned block and
+ * mapping it with a single PDE.  Only done when every page of the
+ * region is eligible and such a block is free right now; never
+ * evicts.  If the PDE cannot be installed the loaded pages are
+ * mapped one by one instead. */
+static bool
+vm_claim_huge_page (struct supplemental_page_table *spt, struct page *page) {
+  uint8_t *base = hpg_round_down (page->va);
+  uint64_t *pml4 = thread_current ()->pml4;
+  uint8_t *kva;
+  size_t i, loaded;
+
+  if (!vm_huge_pages || !page_huge_eligible (page, page))
+    return false;
+  if (spt->rss_limit != 0 && spt->resident_cnt + HPGCNT > spt->rss_limit) // 2MB를 올리면 제한을 넘는 경우
+    return false;
+  for (i = 0; i < HPGCNT; i++) // 2MB 안의 모든 page가 조건을 만족해야 함
+    if (!page_huge_eligible (spt_find_page (spt, base + i * PGSIZE), page))
+      return false;
+
+  kva = palloc_get_aligned (PAL_USER, HPGCNT, HPGCNT);
+  if (kva == NULL) // 연속된 2MB가 없으면 평소처럼 4KB 단위로 처리
+    return false;
+
+  for (loaded = 0; loaded < HPGCNT; loaded++) {
+    struct page *p = spt_find_page (spt, base + loaded * PGSIZE);
+    struct frame *frame = (struct frame *) malloc (sizeof (struct frame));
+    if (frame == NULL)
+      break;
+    frame->kva = kva + loaded * PGSIZE; // 2MB 안의 4KB 조각들도 각각 frame으로 관리해야 따로 evict 할 수 있음
+    frame->page = p;
+    frame->zeroed = false;
+    frame->writeback = false;
+    frame->ksm_unstable = false;
+    p->frame = frame;
+    if (!swap_in (p, frame->kva)) {
+      p->frame = NULL;
+      free (frame);
+      break;
+    }
+  }
+
+  if (loaded == HPGCNT && pml4_set_huge_page (pml4, base, kva, page->writable))
+    vm_huge_mapped++;
+  else {
+    // 2MB를 한번에 매핑하지 못했다면 올라온 page들만 4KB 단위로 매핑하고 나머지는 돌려줌
+    for (i = 0; i < loaded; i++)
+      pml4_set_page (pml4, base + i * PGSIZE, kva + i * PGSIZE, page->writable);
+    for (i = loaded; i < HPGCNT; i++)
+      palloc_free_page (kva + i * PGSIZE);
+  }
+
+  lock_acquire (&frame_lock); // 매핑까지 끝난 frame들만 evict 대상이 됨
+  for (i = 0; i < loaded; i++) {
+    struct frame *frame = spt_find_page (spt, base + i * PGSIZE)->frame;
+    frame_charge (frame, spt);
+    list_push_back (&frame_table, &frame->elem_fr);
+  }
+  lock_release (&frame_lock);
+  return page->frame != NULL;
+}
+
+/* Prints virtual memory statistics. */
+void
+vm_print_stats (void) {
+  if (vm_huge_mapped > 0)
+    printf ("Huge pages: %zu mapped, %zu split\n", vm_huge_mapped, pml4_huge_splits);
+  if (kswapd_reclaimed > 0)
+    printf ("kswapd: %llu frames reclaimed in the background\n", kswapd_reclaimed);
+
+  for (int c = 0; c < VM_FAULT_CLASS_CNT; c++) {
+    if (fault_total_cnt[c] == 0)
+      continue;
+    printf ("Page faults (%s): %llu, avg %llu cycles, log2 histogram:", fault_class_names[c],
+            fault_total_cnt[c], fault_total_cycles[c] / fault_total_cnt[c]);
+    for (int b = 0; b < FAULT_HIST_BUCKETS; b++)
+      if (fault_hist[c][b] > 0)
+        printf (" %d:%llu", b, fault_hist[c][b]);
+    printf ("\n");
+  }
+}
+
+/* If PAGE is not resident yet and its contents come from a file
+ * (lazily loaded segment or mmap), returns the container that
+ * describes where in the file it lives.  Otherwise returns NULL. */
+struct container *
+page_file_region (struct page *page) {
+  if (page->frame != NULL)
+    return NULL;
+  if (page->operations->type == VM_UNINIT)
+    return page->uninit.init == lazy_load_segment ? page->uninit.aux : NULL;
+  if (page->operations->type == VM_FILE)
+    return page->uninit.aux; // file page는 swap in 할때도 uninit 시절의 aux를 그대로 사용함
+  return NULL;
+}
+
+/* Returns true if PAGE is an anonymous page whose contents are
+ * currently on the swap disk or in the compressed swap cache. */
+bool
+page_in_swap (struct page *page) {
+  return page->frame == NULL && page->operations->type == VM_ANON
+         && (page->anon.swap_index != SWAP_SLOT_NONE || page->anon.zswap != NULL);
+}
+
+/* Fault-around: after the fault on PAGE was served, also populate
+ * up to vm_fault_around following pages that are read from the
+ * same file, right after REGION.  Stops at the first page that does
+ * not continue the run or when no free frame is left.  The madvise()
+ * hint of PAGE turns this off (RANDOM) or doubles it (SEQUENTIAL). */
+static void
+vm_fault_around_pages (struct supplemental_page_table *spt, struct page *page,
+                       struct container *region) {
+  size_t count = vm_fault_around;
+
+  if (page->advice == VM_ADV_RANDOM) // 무작위 접근이라고 알려줬으면 미리 읽지 않음
+    return;
+  if (page->advice == VM_ADV_SEQUENTIAL) // 순차 접근이면 두배로 읽음
+    count *= 2;
+
+  for (size_t i = 1; i <= count; i++) {
+    struct page *next = spt_find_page (spt, page->va + i * PGSIZE);
+    if (next == NULL || text_page_eligible (next)) // code page는 text cache를 거쳐야 하니 미리 private frame에 읽지 않음
+      break;
+
+    struct container *next_region = page_file_region (next);
+    if (next_region == NULL || next_region->file != region->file // 같은 file이 아니거나
+        || next_region->offset != region->offset + (off_t) (i * PGSIZE) // file 안에서 연속된 위치가 아니거나
+        || next_region->read_byte == 0) // 읽을게 없는 page면 굳이 미리 채울 필요가 없음
+      break;
+
+    struct frame *frame = vm_get_free_frame ();
+    if (frame == NULL || !vm_map_frame (next, frame))
+      break;
+  }
+}
+
+/* Adaptive swap read-ahead.  If the fault on PAGE continues the
+ * previous swap-in sequence, the read-ahead window doubles (up to
+ * vm_readahead_max); otherwise it collapses.  The following swapped
+ * out pages inside the window are brought in as well.  Pages advised
+ * SEQUENTIAL get the full window at once, RANDOM ones none. */
+static void
+vm_swap_readahead (struct supplemental_page_table *spt, struct page *page) {
+  if (page->advice == VM_ADV_RANDOM) // 무작위 접근이라고 알려줬으면 미리 읽지 않음
+    return;
+
+  if (page->advice == VM_ADV_SEQUENTIAL) // 순차 접근이라고 알려줬으면 감지할 필요 없이 바로 최대로
+    spt->ra_window = vm_readahead_max;
+  else if (spt->ra_last_va != NULL && page->va == spt->ra_last_va + PGSIZE) // 바로 전에 올렸던 page 다음을 요구한다면 순차 접근
+    spt->ra_window = spt->ra_window ? spt->ra_window * 2 : 1;
+  else
+    spt->ra_window = 0;
+  if (spt->ra_window > vm_readahead_max)
+    spt->ra_window = vm_readahead_max;
+
+  spt->ra_last_va = page->va;
+  for (size_t i = 1; i <= spt->ra_window; i++) {
+    struct page *next = spt_find_page (spt, page->va + i * PGSIZE);
+    if (next == NULL || !page_in_swap (next))
+      break;
+
+    struct frame *frame = vm_get_free_frame ();
+    if (frame == NULL || !vm_map_frame (next, frame))
+      break;
+    spt->ra_last_va = next->va; // 다음 fault는 여기 다음에서 나야 순차 접근임
+  }
+}
+
+/* Takes FRAME out of the frame table and out of the resident set of
+ * its owner.  Must hold frame_lock. */
+void
+vm_frame_detach (struct frame *frame) {
+  frame_uncharge (frame);
+  list_remove (&frame->elem_fr);
+  if (frame->ksm_unstable) // ksm scan 이 짝을 찾으려고 기억해둔 frame이면 잊게 함
+    ksm_forget (frame);
+}
+
+/* Unlinks the frame of PAGE, if it still has one, from the frame
+ * table and frees it together with its physical page, waiting for an
+ * eviction or writeback of it to finish first.  The caller must
+ * already have removed the mapping. */
+void
+vm_frame_free (struct page *page) {
+  struct frame *frame;
+
+  lock_acquire (&frame_lock);
+  vm_frame_settle (page);
+  frame = page->frame;
+  if (frame != NULL)
+    vm_frame_detach (frame);
+  page->frame = NULL;
+  lock_release (&frame_lock);
+  if (frame != NULL) { // 기다리는 동안 내보내졌으면 돌려줄 frame이 없음
+    palloc_free_page (frame->kva);
+    free (frame);
+  }
+}
+
+/* Looks up every page of [ADDR, ADDR + LENGTH) in SPT.  Returns
+ * false if ADDR is not page aligned or any of the pages does not
+ * exist. */
+static bool
+spt_range_valid (struct supplemental_page_table *spt, void *addr, size_t length) {
+  if (pg_ofs (addr) != 0 || length == 0 || !is_user_vaddr (addr + length - 1))
+    return false;
+  for (void *va = addr; va < addr + length; va += PGSIZE)
+    if (spt_find_page (spt, va) == NULL)
+      return false;
+  return true;
+}
+
+/* Changes the writability of the pages in [ADDR, ADDR + LENGTH) to
+ * WRITABLE, including the PTEs of pages that are mapped.  Pages that
+ * still map the shared zero frame stay read-only in the page table
+ * and get a private frame on their first write as usual.  Returns
+ * false, changing nothing, unless the whole range is allocated and
+ * the 2 MiB mappings in it can be split. */
+bool
+vm_mprotect (void *addr, size_t length, bool writable) {
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  struct tlb_gather tlb;
+
+  if (!spt_range_valid (spt, addr, length))
+    return false;
+  for (void *va = addr; va < addr + length; va += PGSIZE) // 바꾸기 전에 쪼갤 수 있는지부터 봐서 반만 바뀌지 않게 함
+    if (!pml4_split_huge_page (thread_current ()->pml4, va))
+      return false;
+
+  tlb_gather_init (&tlb, thread_current ()->pml4);
+  for (void *va = addr; va < addr + length; va += PGSIZE) {
+    struct page *page = spt_find_page (spt, va);
+    page->writable = writable; // 다음에 매핑될 때도 이 권한으로 매핑됨
+    if (page->frame != NULL || page->operations->type == VM_SHM)
+      pml4_set_writable_gather (&tlb, page->va, writable); // 이미 매핑된 page는 PTE도 바로 바꿔줌 -- 위에서 쪼갰으니 실패하지 않음
+  }
+  tlb_gather_finish (&tlb);
+  return true;
+}
+
+/* Drops the frame of PAGE if it has one.  Anonymous contents are
+ * discarded, so the page reads as zeros when touched again; file
+ * backed pages are written back first if dirty and read from the
+ * file again on the next fault.  Returns false, keeping the frame,
+ * if the 2 MiB mapping around PAGE could not be split. */
+static bool
+vm_drop_page (struct page *page, struct tlb_gather *tlb) {
+  uint64_t *pml4 = tlb->pml4;
+
+  if (ksm_page_kva (page) != NULL) { // 합쳐진 page는 공유 frame에서 떼어내기만 하면 다음에 0으로 시작함
+    if (!pml4_clear_page_gather (tlb, page->va))
+      return false;
+    ksm_unmerge (page);
+    return true;
+  }
+  if (page->frame == NULL)
+    return true;
+  if (page->operations->type == VM_FILE)
+    do_msync (page->va, PGSIZE); // 수정된 내용은 file에 써두고 -- writeback 중이면 끝날 때까지 기다림
+  if (!pml4_clear_page_gather (tlb, page->va))
+    return false;
+  pml4_set_dirty (pml4, page->va, false);
+  vm_frame_free (page);
+  return true;
+}
+
+/* Applies access pattern hint ADVICE (enum vm_advice) to the pages
+ * in [ADDR, ADDR + LENGTH):
+ *  - NORMAL, RANDOM, SEQUENTIAL tune fault-around and swap
+ *    read-ahead for those pages;
+ *  - WILLNEED loads pages that are not resident yet, as long as free
+ *    frames are available;
+ *  - DONTNEED frees the frames of resident pages (see vm_drop_page).
+ * Returns false unless the whole range is allocated and ADVICE is
+ * known, or if DONTNEED had to stop at a page it could not drop. */
+bool
+vm_madvise (void *addr, size_t length, int advice) {
+  struct supplemental_page_table *spt = &thread_current ()->spt;
+  struct tlb_gather tlb;
+  bool success = true;
 
-  return false; // 실패했다면 false를 return 함
+  if (advice < VM_ADV_NORMAL || advice > VM_ADV_DONTNEED
+      || !spt_range_valid (spt, addr, length))
+    return false;
+
+  tlb_gather_init (&tlb, thread_current ()->pml4);
+  for (void *va = addr; success && va < addr + length; va += PGSIZE) {
+    struct page *page = spt_find_page (spt, va);
+
+    switch (advice) {
+    case VM_ADV_WILLNEED:
+      if (page->operations->type == VM_SHM || page->operations->type == VM_TEXT
+          || text_page_eligible (page)) {
+        if (pml4_get_page (tlb.pml4, page->va) == NULL)
+          vm_do_claim_page (page);
+      } else if (page->frame == NULL && !page->zero_mapped && ksm_page_kva (page) == NULL) {
+        struct frame *frame = vm_get_free_frame (); // 다른 page를 쫓아내면서까지 미리 올리지는 않음
+        if (frame != NULL)
+          vm_map_frame (page, frame); // 미리 올리는 것이니 실패해도 다음 fault에서 다시 시도됨
+      }
+      break;
+    case VM_ADV_DONTNEED:
+      success = vm_drop_page (page, &tlb);
+      break;
+    default:
+      page->advice = advice;
+      break;
+    }
+  }
+  tlb_gather_finish (&tlb);
+  return success;
 }
 
 /* Initialize new supplemental page table */
 void
 supplemental_page_table_init (struct supplemental_page_table *spt UNUSED) {
   hash_init (&spt->pages, page_hash, page_cmp_less, NULL);
+  spt->ra_last_va = NULL;
+  spt->ra_window = 0;
+  spt->resident_cnt = 0;
+  spt->resident_peak = 0;
+  spt->rss_limit = 0;
+  spt->self_evict_cnt = 0;
+  spt->ksm_cnt = 0;
+  spt->ws_size = 0;
+  spt->ws_stamp = timer_ticks ();
+  memset (spt->fault_cnt, 0, sizeof spt->fault_cnt);
+  memset (spt->fault_cycles, 0, sizeof spt->fault_cycles);
+}
+
+/* Estimates the working set of SPT, the current process: counts the
+ * resident pages that were accessed since the previous sample and
+ * clears their accessed bits for the next interval. */
+void
+vm_ws_sample (struct supplemental_page_table *spt) {
+  struct tlb_gather tlb;
+  size_t referenced = 0;
+  struct list_elem *e;
+
+  tlb_gather_init (&tlb, thread_current ()->pml4);
+  lock_acquire (&frame_lock);
+  for (e = list_begin (&frame_table); e != list_end (&frame_table); e = list_next (e)) {
+    struct frame *frame = list_entry (e, struct frame, elem_fr);
+    if (frame->owner != spt)
+      continue;
+    if (pml4_test_and_clear_accessed_gather (&tlb, frame->page->va))
+      referenced++;
+  }
+  lock_release (&frame_lock);
+  tlb_gather_finish (&tlb);
+
+  spt->ws_size = referenced;
+  spt->ws_stamp = timer_ticks ();
 }
 
 /* Copy supplemental page table from src to dst */
@@ -270,6 +1187,8 @@ supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED, struct
 
   struct hash_iterator i; // hash를 순회하기위해서 사용
 
+  dst->rss_limit = src->rss_limit; // resident 제한은 자식에게도 물려줌
+
   hash_first (&i, &src->pages); // hash 순회를 위한 준비를 함 초기화와 비슷
   while (hash_next (&i)) { // hash를 하나씩 next로 옮기면서 순회함
     struct page *parent_page = hash_entry (hash_cur (&i), struct page, elem_hash); // input된 hash를 이용해서 page로 확장을 함
@@ -279,23 +1198,36 @@ supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED, struct
 
     vm_initializer *init = parent_page->uninit.init;
 
-    struct container *child_aux = (struct container *) malloc (sizeof (struct container)); // 복사를 위한 child_aux를 선언해주고
-
-    struct container *aux = (struct container *) parent_page->uninit.aux; // 부모 aux를 사용하기 위하여 container로 연결
-
-    if (child_aux == NULL)
-      return false;
-    if (aux != NULL) { // 부모의 aux를 child_aux의 container에 저장해줌
-      child_aux->file = aux->file;
-      child_aux->offset = aux->offset;
-      child_aux->read_byte = aux->read_byte;
+    if (parent_page->operations->type == VM_SHM) { // 공유 memory는 복사하지 않고 자식도 같은 frame을 매핑하게 함
+      if (!shm_share_page (parent_page))
+        return false;
+      continue;
     }
-   
-    if (parent_page->uninit.type & VM_MARKER_0) { // 부모의 type 에 stack 이 check 되어있다면
-        setup_stack (&thread_current ()->tf); // lazy load가 아닌 바로 setup_stack으로 보내서 동작함
-      } else if (parent_page->operations->type == VM_UNINIT) { // type이 초기 상태이면
-        if (!vm_alloc_page_with_initializer (type, upage, writable, init, (void *) child_aux)) // vm_alloc을 이용하여 초기화하고 page를 할당받음
+    if (parent_page->operations->type == VM_TEXT) { // code page도 자식이 같은 text cache entry를 매핑함
+      if (!text_share_page (parent_page))
+        return false;
+      continue;
+    }
+
+    // stack page도 다른 anonymous page와 같이 할당 후 내용을 복사함
+    // (claim 된 page의 uninit.type 자리는 anon_page가 덮어쓰므로 VM_MARKER_0로 구분할 수 없음)
+    if (parent_page->operations->type == VM_UNINIT) { // type이 초기 상태이면
+        // claim 된 page의 uninit.aux 자리는 anon.ksm 같은 다른 정보가 덮어쓰므로 uninit 일 때만 읽음
+        struct container *aux = (struct container *) parent_page->uninit.aux; // 부모 aux를 사용하기 위하여 container로 연결
+        struct container *child_aux = NULL;
+
+        if (aux != NULL) { // 부모의 aux를 child_aux의 container에 저장해줌
+          child_aux = (struct container *) malloc (sizeof (struct container)); // 복사를 위한 child_aux를 선언해주고
+          if (child_aux == NULL)
+            return false;
+          child_aux->file = aux->file;
+          child_aux->offset = aux->offset;
+          child_aux->read_byte = aux->read_byte;
+        }
+        if (!vm_alloc_page_with_initializer (type, upage, writable, init, (void *) child_aux)) { // vm_alloc을 이용하여 초기화하고 page를 할당받음
+          free (child_aux);
           return false;
+        }
       } else {
         if (!vm_alloc_page (type, upage, writable)) // 초기 상태가 아닌 ANON 혹은 FILE type 이라면 vm_alloc_page로 page를 할당 받고
           return false;
@@ -307,9 +1239,14 @@ supplemental_page_table_copy (struct supplemental_page_table *dst UNUSED, struct
         struct page *child_page = spt_find_page (dst, upage); // child_page를 dst 에서 찾고
         if (child_page == NULL)
           return false;
-        memcpy (child_page->frame->kva, parent_page->frame->kva, PGSIZE); // parent page의 정보를 child page 에 복사해넣음
+        void *src = parent_page->frame != NULL ? parent_page->frame->kva : ksm_page_kva (parent_page); // ksm으로 합쳐진 page는 공유 frame에서 복사 (다음 scan에서 다시 합쳐짐)
+        memcpy (child_page->frame->kva, src, PGSIZE); // parent page의 정보를 child page 에 복사해넣음
       }
 
+      struct page *child_page = spt_find_page (dst, upage);
+      if (child_page != NULL)
+        child_page->advice = parent_page->advice; // madvise 로 준 접근 패턴도 물려받음
+
        // if (parent_page->operations->type == VM_UNINIT) {
     //   ASSERT (child_aux != NULL);
     //   if (!vm_alloc_page_with_initializer (type, upage, writable, init, (void *) child_aux))
@@ -336,15 +1273,24 @@ supplemental_page_table_kill (struct supplemental_page_table *spt UNUSED) {
    * TODO: writeback all the modified contents to the storage. */
 
   struct hash_iterator i;
-  hash_first (&i, &spt->pages);
-  while (hash_next (&i)) {
-    struct page *page = hash_entry (hash_cur (&i), struct page, elem_hash);
-
-    if (page->operations->type == VM_FILE) // hash를 순회하면서 type이 VM_FILE 이라면
-      do_munmap (page->va); // 내부를 전부 munmap 해서 data를 free 해버리고
-
-    // free(page);
+  struct tlb_gather tlb;
+  tlb_gather_init (&tlb, thread_current ()->pml4); // 모든 mapping의 TLB 무효화를 모아서 마지막에 한번만 함
+  for (;;) {
+    struct page *mapped = NULL;
+
+    hash_first (&i, &spt->pages);
+    while (hash_next (&i)) {
+      struct page *page = hash_entry (hash_cur (&i), struct page, elem_hash);
+      if (page_get_type (page) == VM_FILE) { // hash를 순회하면서 type이 VM_FILE 인 page를 찾음
+        mapped = page;
+        break;
+      }
+    }
+    if (mapped == NULL)
+      break;
+    do_munmap_gather (mapped->va, &tlb); // 내부를 전부 munmap 해서 data를 free 해버리고 -- spt에서 지워지니 순회를 처음부터 다시 함
   }
+  tlb_gather_finish (&tlb);
   // hash_destroy(&spt->pages, spt_des);
   hash_clear (&spt->pages, spt_des); // clear를 통해서 hash_table을 날려버림
 }
@@ -383,9 +1329,19 @@ delete_page (struct hash *pages, struct page *p) {
 
 void
 spt_des (struct hash_elem *e, void *aux) {
-  const struct page *p = hash_entry (e, struct page, elem_hash);
-  // vm_dealloc_page (p);
-  free (p); // input된 e를 확장해서 page를 free 함
+  struct page *p = hash_entry (e, struct page, elem_hash);
+  struct frame *frame;
+
+  lock_acquire (&frame_lock);
+  vm_frame_settle (p); // 다른 thread가 내보내는 중이면 끝날 때까지 기다림
+  frame = p->frame;
+  if (frame != NULL) { // physical page는 pml4_destroy가 돌려주니 frame 정보만 정리함
+    vm_frame_detach (frame);
+    p->frame = NULL;
+  }
+  lock_release (&frame_lock);
+  free (frame);
+  vm_dealloc_page (p); // destroy를 거쳐서 swap slot 같은 page의 자원을 돌려준 후 page를 free 함
 }
 
 void
@@ -0,0 +1,312 @@
+/* zswap.c: Compressed in-memory cache in front of the swap disk.
+ *
+ * anon_swap_out 에서 내쫓기는 page를 바로 swap disk에 쓰지 않고 먼저 압축해서
+ * kernel pool에서 따로 떼어둔 zswap pool에 보관함. pool이 가득 차면 가장 오래된
+ * entry부터 압축을 풀어서 swap disk로 내려보냄 (writeback). 모든 byte가 같은
+ * 값인 page (대부분 0으로 채워진 page)는 pool 공간을 전혀 쓰지 않고 값만 기억함. */
+
+#include "vm/zswap.h"
+#include <debug.h>
+#include <inttypes.h>
+#include <list.h>
+#include <round.h>
+#include <stdio.h>
+#include <string.h>
+#include "vm/vm.h"
+#include "kernel/bitmap.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* pool은 ZSWAP_CHUNK_SIZE byte 단위로 나눠서 할당함 */
+#define ZSWAP_CHUNK_SIZE 64
+/* 압축 결과가 이것보다 크면 보관할 이득이 없으니 바로 disk로 보냄 */
+#define ZSWAP_MAX_SIZE (PGSIZE * 3 / 4)
+
+/* LZ77 계열 압축기.
+ * control byte 하나 뒤에 최대 8개의 item이 오고, control byte의 bit i가 0이면
+ * i번째 item은 literal 1 byte, 1이면 match 2 byte (12bit offset, 4bit 길이)임. */
+#define LZ_HASH_BITS 12
+#define LZ_MIN_MATCH 3
+#define LZ_MAX_MATCH (LZ_MIN_MATCH + 15)
+#define LZ_MAX_OFFSET 4095
+
+/* 압축된 page 하나 */
+struct zswap_entry {
+	struct page *page;       /* 이 entry를 가지고 있는 anonymous page */
+	struct list_elem elem;   /* zswap_lru 의 원소 */
+	size_t chunk;            /* pool 안에서 시작 chunk 번호 */
+	size_t chunk_cnt;        /* 사용하는 chunk 개수, same-filled page는 0 */
+	size_t length;           /* 압축된 크기 (byte) */
+	uint64_t fill;           /* same-filled page의 반복되는 값 */
+};
+
+size_t zswap_pool_pages = 32;
+
+static struct lock zswap_lock;     /* 아래의 모든 정보와 anon_page.zswap을 보호함 */
+static uint8_t *zswap_pool;        /* 압축된 page들이 저장되는 공간 */
+static struct bitmap *zswap_chunks;/* pool의 chunk 별 사용 여부 */
+static struct list zswap_lru;      /* 오래된 entry가 앞에 오는 list */
+static uint8_t *zswap_scratch;     /* writeback 할 때 압축을 풀어둘 page */
+static uint8_t zswap_cbuf[ZSWAP_MAX_SIZE]; /* 압축 결과를 먼저 받아두는 buffer */
+static uint16_t lz_table[1 << LZ_HASH_BITS]; /* 3 byte hash -> 마지막 위치 + 1 */
+
+/* 통계 */
+static uint64_t stat_stored;       /* zswap에 저장된 page 수 */
+static uint64_t stat_same_filled;  /* 그 중 same-filled page 수 */
+static uint64_t stat_rejected;     /* 압축이 안되거나 공간이 없어서 disk로 보낸 page 수 */
+static uint64_t stat_written_back; /* pool이 차서 disk로 내려보낸 page 수 */
+static uint64_t stat_orig_bytes;   /* 압축한 page들의 원래 크기 합 */
+static uint64_t stat_comp_bytes;   /* 압축한 page들의 압축 후 크기 합 */
+
+/* Sets up the compressed pool.  Called from vm_anon_init(). */
+void
+zswap_init (void) {
+	lock_init (&zswap_lock);
+	list_init (&zswap_lru);
+	if (zswap_pool_pages == 0)
+		return;
+
+	zswap_pool = palloc_get_multiple (0, zswap_pool_pages);
+	zswap_scratch = palloc_get_page (0);
+	zswap_chunks = bitmap_create (zswap_pool_pages * (PGSIZE / ZSWAP_CHUNK_SIZE));
+	if (zswap_pool == NULL || zswap_scratch == NULL || zswap_chunks == NULL) {
+		printf ("zswap: cannot allocate %zu page pool, disabled\n", zswap_pool_pages);
+		if (zswap_pool != NULL)
+			palloc_free_multiple (zswap_pool, zswap_pool_pages);
+		if (zswap_scratch != NULL)
+			palloc_free_page (zswap_scratch);
+		if (zswap_chunks != NULL)
+			bitmap_destroy (zswap_chunks);
+		zswap_pool = NULL;
+	}
+}
+
+/* Returns true if the page at KVA consists of a single repeated
+ * 8-byte word, storing that word in *FILL. */
+static bool
+page_same_filled (const void *kva, uint64_t *fill) {
+	const uint64_t *w = kva;
+
+	for (size_t i = 1; i < PGSIZE / sizeof *w; i++)
+		if (w[i] != w[0])
+			return false;
+	*fill = w[0];
+	return true;
+}
+
+static inline uint32_t
+lz_hash (const uint8_t *p) {
+	uint32_t v = p[0] | (p[1] << 8) | (p[2] << 16);
+	return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+/* Compresses the page at SRC into DST.  Returns the compressed
+ * length, or 0 if it would not fit in LIMIT bytes. */
+static size_t
+lz_compress (const uint8_t *src, uint8_t *dst, size_t limit) {
+	size_t ip = 0, op = 0;
+	size_t ctrl = 0;
+	int bit = 8;
+
+	memset (lz_table, 0, sizeof lz_table);
+	while (ip < PGSIZE) {
+		if (bit == 8) { // 8개 item 마다 새 control byte
+			if (op >= limit)
+				return 0;
+			ctrl = op++;
+			dst[ctrl] = 0;
+			bit = 0;
+		}
+
+		size_t len = 0, off = 0;
+		if (ip + LZ_MIN_MATCH <= PGSIZE) {
+			uint32_t h = lz_hash (src + ip);
+			size_t cand = lz_table[h];
+			lz_table[h] = ip + 1;
+			if (cand != 0 && ip - (cand - 1) <= LZ_MAX_OFFSET) { // 같은 hash를 가진 이전 위치와 비교
+				size_t max = PGSIZE - ip < LZ_MAX_MATCH ? PGSIZE - ip : LZ_MAX_MATCH;
+				off = ip - (cand - 1);
+				while (len < max && src[ip - off + len] == src[ip + len])
+					len++;
+			}
+		}
+
+		if (len >= LZ_MIN_MATCH) {
+			if (op + 2 > limit)
+				return 0;
+			dst[ctrl] |= 1 << bit;
+			dst[op++] = off & 0xff;
+			dst[op++] = ((off >> 8) << 4) | (len - LZ_MIN_MATCH);
+			ip += len;
+		} else {
+			if (op + 1 > limit)
+				return 0;
+			dst[op++] = src[ip++];
+		}
+		bit++;
+	}
+	return op;
+}
+
+/* Decompresses LEN bytes at SRC into the page at DST. */
+static void
+lz_decompress (const uint8_t *src, size_t len, uint8_t *dst) {
+	size_t ip = 0, op = 0;
+
+	while (ip < len) {
+		uint8_t ctrl = src[ip++];
+		for (int bit = 0; bit < 8 && ip < len; bit++) {
+			if (ctrl & (1 << bit)) {
+				size_t off = src[ip] | ((src[ip + 1] >> 4) << 8);
+				size_t n = (src[ip + 1] & 0xf) + LZ_MIN_MATCH;
+				ip += 2;
+				ASSERT (off <= op && op + n <= PGSIZE);
+				for (; n > 0; n--, op++) // offset이 길이보다 짧을 수 있으니 1 byte 씩 복사
+					dst[op] = dst[op - off];
+			} else {
+				ASSERT (op < PGSIZE);
+				dst[op++] = src[ip++];
+			}
+		}
+	}
+	ASSERT (op == PGSIZE);
+}
+
+/* Restores the contents of ENTRY into the page at KVA. */
+static void
+zswap_decompress (struct zswap_entry *entry, void *kva) {
+	if (entry->chunk_cnt == 0) {
+		uint64_t *w = kva;
+		for (size_t i = 0; i < PGSIZE / sizeof *w; i++)
+			w[i] = entry->fill;
+	} else
+		lz_decompress (zswap_pool + entry->chunk * ZSWAP_CHUNK_SIZE, entry->length, kva);
+}
+
+/* Removes ENTRY from the pool and frees it. */
+static void
+zswap_free_entry (struct zswap_entry *entry) {
+	if (entry->chunk_cnt > 0)
+		bitmap_set_multiple (zswap_chunks, entry->chunk, entry->chunk_cnt, false);
+	list_remove (&entry->elem);
+	entry->page->anon.zswap = NULL;
+	free (entry);
+}
+
+/* Writes the oldest entry that occupies pool space back to the swap
+ * disk.  Returns false if there is none or the swap disk is full. */
+static bool
+zswap_writeback_oldest (void) {
+	struct list_elem *e;
+
+	ASSERT (lock_held_by_current_thread (&zswap_lock));
+	for (e = list_begin (&zswap_lru); e != list_end (&zswap_lru); e = list_next (e)) {
+		struct zswap_entry *entry = list_entry (e, struct zswap_entry, elem);
+		if (entry->chunk_cnt == 0) // same-filled page는 pool 공간을 차지하지 않음
+			continue;
+
+		zswap_decompress (entry, zswap_scratch);
+		if (!anon_swap_write (entry->page, zswap_scratch))
+			return false;
+		zswap_free_entry (entry);
+		stat_written_back++;
+		return true;
+	}
+	return false;
+}
+
+/* Tries to keep the contents of PAGE, currently at KVA, in the
+ * compressed pool.  Returns false if the page should go to the swap
+ * disk instead. */
+bool
+zswap_store (struct page *page, const void *kva) {
+	struct zswap_entry *entry;
+
+	if (zswap_pool == NULL)
+		return false;
+
+	entry = malloc (sizeof *entry);
+	if (entry == NULL)
+		return false;
+	entry->page = page;
+	entry->chunk_cnt = 0;
+	entry->length = 0;
+
+	lock_acquire (&zswap_lock);
+	if (page_same_filled (kva, &entry->fill)) {
+		stat_same_filled++;
+	} else {
+		entry->length = lz_compress (kva, zswap_cbuf, ZSWAP_MAX_SIZE);
+		if (entry->length == 0)
+			goto reject;
+
+		entry->chunk_cnt = DIV_ROUND_UP (entry->length, ZSWAP_CHUNK_SIZE);
+		while ((entry->chunk = bitmap_scan_and_flip (zswap_chunks, 0, entry->chunk_cnt, false))
+		       == BITMAP_ERROR) {
+			if (!zswap_writeback_oldest ()) // pool이 꽉 찼으면 오래된 entry를 disk로 내림
+				goto reject;
+		}
+		memcpy (zswap_pool + entry->chunk * ZSWAP_CHUNK_SIZE, zswap_cbuf, entry->length);
+		stat_orig_bytes += PGSIZE;
+		stat_comp_bytes += entry->length;
+	}
+
+	list_push_back (&zswap_lru, &entry->elem);
+	page->anon.zswap = entry;
+	stat_stored++;
+	lock_release (&zswap_lock);
+	return true;
+
+reject:
+	stat_rejected++;
+	lock_release (&zswap_lock);
+	free (entry);
+	return false;
+}
+
+/* If PAGE is held in the compressed pool, decompresses it into KVA,
+ * drops it from the pool and returns true.  Returns false if the page
+ * is not (or no longer) in the pool. */
+bool
+zswap_load (struct page *page, void *kva) {
+	struct zswap_entry *entry;
+
+	lock_acquire (&zswap_lock);
+	entry = page->anon.zswap; // writeback 중에 바뀔 수 있으므로 lock을 잡고 확인
+	if (entry != NULL) {
+		zswap_decompress (entry, kva);
+		zswap_free_entry (entry);
+	}
+	lock_release (&zswap_lock);
+	return entry != NULL;
+}
+
+/* Drops PAGE from the compressed pool, if it is there. */
+void
+zswap_invalidate (struct page *page) {
+	lock_acquire (&zswap_lock);
+	if (page->anon.zswap != NULL)
+		zswap_free_entry (page->anon.zswap);
+	lock_release (&zswap_lock);
+}
+
+/* Prints zswap statistics. */
+void
+zswap_print_stats (void) {
+	if (zswap_pool == NULL || stat_stored + stat_rejected == 0)
+		return;
+
+	printf ("Zswap: %"PRIu64" pages stored (%"PRIu64" same-filled), "
+	        "%"PRIu64" rejected, %"PRIu64" written back\n",
+	        stat_stored, stat_same_filled, stat_rejected, stat_written_back);
+	if (stat_comp_bytes > 0) {
+		uint64_t ratio = stat_orig_bytes * 100 / stat_comp_bytes;
+		printf ("Zswap: compression ratio %"PRIu64".%02"PRIu64":1 "
+		        "(%"PRIu64" bytes -> %"PRIu64" bytes)\n",
+		        ratio / 100, ratio % 100, stat_orig_bytes, stat_comp_bytes);
+	}
+	printf ("Zswap: %"PRIu64" swap disk page writes avoided\n",
+	        stat_stored - stat_written_back);
+}